@@ -0,0 +1,390 @@
+/*
+    E/S de datagramas em lote para o protocolo FTP sobre UDP
+    Usado pelo motor Sliding Window (o Stop and Wait tem um pacote por vez)
+
+    Um PacketBatch é um vetor pré-alocado de IO_BATCH buffers no formato do
+    fio (ver protocol.h):
+      - envio: batch_add() codifica os pacotes de uma rajada e batch_flush()
+        entrega todos com um único sendmmsg; batch_add_data() só codifica o
+        cabeçalho e referencia o payload (ex.: arquivo mapeado), que vai
+        como segundo iovec do datagrama sem cópia em espaço de usuário
+      - recepção: batch_recv() espera o primeiro datagrama e drena os que já
+        estiverem na fila com um único recvmmsg; batch_packet() decodifica
+
+    Modo offload (--gso, Linux): a rajada de envio vira super-datagramas com
+    UDP_SEGMENT (GSO), pacotes consecutivos para o mesmo destino que o kernel
+    fatia em segmentos do tamanho do primeiro; na recepção, UDP_GRO entrega
+    os segmentos coalescidos em buffers de 64 KB que batch_recv() separa de
+    novo. Se o kernel não suportar, o lote volta ao caminho normal.
+
+    Fora do Linux o mesmo código usa sendto em laço e um recvfrom por chamada.
+*/
+#ifndef FTP_BATCH_IO_H
+#define FTP_BATCH_IO_H
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <stdlib.h>
+
+#include "protocol.h"
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+#define IO_BATCH 64
+#define GSO_MAX_SEGMENTS 64             // limite do kernel por super-datagrama
+#define GSO_MAX_BYTES 65507             // payload UDP máximo
+#define GRO_MSGS 4                      // buffers coalescidos por recvmmsg
+#define GRO_BUF_LEN 65536
+#define IO_RECV_MAX (GRO_MSGS * GSO_MAX_SEGMENTS)
+
+// Modo offload pedido na linha de comando (--gso)
+static int io_offload = 0;
+
+typedef struct {
+    unsigned char bufs[IO_BATCH][WIRE_MAX_LEN];
+    // Envio: payload referenciado fora de bufs (NULL quando já foi codificado)
+    const unsigned char *payload[IO_BATCH];
+    int payload_lens[IO_BATCH];
+    // Datagramas do lote: no envio, data[i] == bufs[i]; na recepção com GRO,
+    // data[i] aponta para o segmento dentro de gro_buf
+    unsigned char *data[IO_RECV_MAX];
+    int lens[IO_RECV_MAX];
+    struct sockaddr_in addrs[IO_RECV_MAX];
+    socklen_t addr_lens[IO_RECV_MAX];
+    int count;
+    struct iovec iov[2 * IO_BATCH];     // envio: cabeçalho + payload por pacote
+    int gso;                            // envio com UDP_SEGMENT
+    unsigned char *gro_buf;             // recepção com UDP_GRO (GRO_MSGS x GRO_BUF_LEN)
+    int gro_sockfd;                     // socket com UDP_GRO ligado
+#ifdef __linux__
+    struct mmsghdr msgs[IO_BATCH];
+    char ctrl[IO_BATCH][CMSG_SPACE(sizeof(int))];
+#endif
+} PacketBatch;
+
+// Liga GSO nos envios do lote se o kernel suportar; retorna 1 se ligado
+static inline int batch_enable_gso(int sockfd, PacketBatch *b)
+{
+    b->gso = 0;
+#ifdef __linux__
+    int zero = 0;   // tamanho vai por mensagem (cmsg); aqui só testa o suporte
+    if (setsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &zero, sizeof(zero)) == 0) b->gso = 1;
+#else
+    (void)sockfd;
+#endif
+    return b->gso;
+}
+
+// Liga GRO no socket e aloca os buffers coalescidos; retorna 1 se ligado
+static inline int batch_enable_gro(int sockfd, PacketBatch *b)
+{
+#ifdef __linux__
+    int one = 1;
+    if (b->gro_buf) return 1;
+    if (setsockopt(sockfd, SOL_UDP, UDP_GRO, &one, sizeof(one)) != 0) return 0;
+    b->gro_buf = (unsigned char*)malloc(GRO_MSGS * GRO_BUF_LEN);
+    if (!b->gro_buf) {
+        int zero = 0;
+        setsockopt(sockfd, SOL_UDP, UDP_GRO, &zero, sizeof(zero));
+        return 0;
+    }
+    b->gro_sockfd = sockfd;
+    return 1;
+#else
+    (void)sockfd; (void)b;
+    return 0;
+#endif
+}
+
+// Libera os buffers de GRO e desliga o GRO do socket, que pode continuar em
+// uso por lotes sem buffers coalescidos (ex.: socket do cliente)
+static inline void batch_free(PacketBatch *b)
+{
+#ifdef __linux__
+    if (b->gro_buf) {
+        int zero = 0;
+        setsockopt(b->gro_sockfd, SOL_UDP, UDP_GRO, &zero, sizeof(zero));
+    }
+#endif
+    free(b->gro_buf);
+    b->gro_buf = NULL;
+}
+
+// Dois iovecs por pacote: bytes codificados em bufs[i] e o payload
+// referenciado (vazio quando o pacote foi codificado inteiro)
+static inline void batch_build_iov(PacketBatch *b)
+{
+    for (int i = 0; i < b->count; i++) {
+        b->iov[2 * i].iov_base = b->bufs[i];
+        b->iov[2 * i].iov_len = b->lens[i] - b->payload_lens[i];
+        b->iov[2 * i + 1].iov_base = (void*)b->payload[i];
+        b->iov[2 * i + 1].iov_len = b->payload_lens[i];
+    }
+}
+
+#ifdef __linux__
+static inline int same_addr(const struct sockaddr_in *a, const struct sockaddr_in *b)
+{
+    return a->sin_port == b->sin_port && a->sin_addr.s_addr == b->sin_addr.s_addr;
+}
+
+// Uma mensagem por pacote, a partir do pacote from
+static inline int batch_send_plain(int sockfd, PacketBatch *b, int from)
+{
+    int sent = 0;
+    batch_build_iov(b);
+    for (int i = from; i < b->count; i++) {
+        memset(&b->msgs[i].msg_hdr, 0, sizeof(b->msgs[i].msg_hdr));
+        b->msgs[i].msg_hdr.msg_name = &b->addrs[i];
+        b->msgs[i].msg_hdr.msg_namelen = b->addr_lens[i];
+        b->msgs[i].msg_hdr.msg_iov = &b->iov[2 * i];
+        b->msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+    while (from + sent < b->count) {
+        io_count(&io_stats.send_calls);
+        int n = sendmmsg(sockfd, b->msgs + from + sent, b->count - from - sent, 0);
+        if (n <= 0) break;
+        sent += n;
+    }
+    return sent;
+}
+
+// Agrupa pacotes consecutivos para o mesmo destino em super-datagramas:
+// todos os segmentos têm o tamanho do primeiro, exceto o último, que pode
+// ser menor. Retorna quantos pacotes foram aceitos ou -1 se o kernel
+// recusar o GSO antes de aceitar qualquer mensagem
+static inline int batch_send_gso(int sockfd, PacketBatch *b)
+{
+    int first[IO_BATCH];    // primeiro pacote de cada mensagem
+    int msgs = 0;
+    
+    batch_build_iov(b);
+    
+    int i = 0;
+    while (i < b->count) {
+        int seg = b->lens[i];
+        int max_segs = GSO_MAX_BYTES / seg;
+        if (max_segs > GSO_MAX_SEGMENTS) max_segs = GSO_MAX_SEGMENTS;
+        
+        int j = i + 1;
+        while (j < b->count && j - i < max_segs && same_addr(&b->addrs[j], &b->addrs[i]) &&
+               b->lens[j - 1] == seg && b->lens[j] <= seg) {
+            j++;
+        }
+        
+        struct msghdr *hdr = &b->msgs[msgs].msg_hdr;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->msg_name = &b->addrs[i];
+        hdr->msg_namelen = b->addr_lens[i];
+        hdr->msg_iov = &b->iov[2 * i];
+        hdr->msg_iovlen = 2 * (j - i);
+        if (j - i > 1) {
+            hdr->msg_control = b->ctrl[msgs];
+            hdr->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+            struct cmsghdr *cm = CMSG_FIRSTHDR(hdr);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t seg_size = (uint16_t)seg;
+            memcpy(CMSG_DATA(cm), &seg_size, sizeof(seg_size));
+        }
+        first[msgs++] = i;
+        i = j;
+    }
+    
+    int done = 0;
+    while (done < msgs) {
+        io_count(&io_stats.send_calls);
+        int n = sendmmsg(sockfd, b->msgs + done, msgs - done, 0);
+        if (n <= 0) {
+            if (done == 0 && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP ||
+                              errno == ENOPROTOOPT)) {
+                return -1;
+            }
+            break;
+        }
+        done += n;
+    }
+    return done < msgs ? first[done] : b->count;
+}
+#endif
+
+// Envia os pacotes acumulados; retorna quantos o kernel aceitou.
+// Os que não couberem no buffer do socket são perdidos como na rede
+// (a retransmissão por timeout cobre)
+static inline int batch_flush(int sockfd, PacketBatch *b)
+{
+    int sent = 0;
+#ifdef __linux__
+    if (b->gso && b->count > 1) {
+        sent = batch_send_gso(sockfd, b);
+        if (sent == -1) {
+            // Kernel/interface sem GSO: desliga e reenvia o lote sem offload
+            printf("⚠️  UDP_SEGMENT indisponível, enviando sem GSO\n");
+            b->gso = 0;
+            sent = batch_send_plain(sockfd, b, 0);
+        }
+    } else {
+        sent = batch_send_plain(sockfd, b, 0);
+    }
+#else
+    batch_build_iov(b);
+    for (int i = 0; i < b->count; i++) {
+        struct msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_name = &b->addrs[i];
+        hdr.msg_namelen = b->addr_lens[i];
+        hdr.msg_iov = &b->iov[2 * i];
+        hdr.msg_iovlen = 2;
+        io_count(&io_stats.send_calls);
+        if (sendmsg(sockfd, &hdr, 0) >= 0) sent++;
+    }
+#endif
+    b->count = 0;
+    return sent;
+}
+
+// Acrescenta um pacote à rajada (esvazia o lote antes se estiver cheio)
+static inline void batch_add(int sockfd, PacketBatch *b, const Packet *pkt,
+                             const struct sockaddr_in *addr, socklen_t addr_len)
+{
+    if (b->count == IO_BATCH) batch_flush(sockfd, b);
+    b->data[b->count] = b->bufs[b->count];
+    b->lens[b->count] = packet_encode(pkt, b->bufs[b->count]);
+    b->payload[b->count] = NULL;
+    b->payload_lens[b->count] = 0;
+    b->addrs[b->count] = *addr;
+    b->addr_lens[b->count] = addr_len;
+    b->count++;
+}
+
+// Acrescenta um pacote DATA sem copiar o payload: só o cabeçalho é codificado
+// e o payload continua onde está até o envio (lens[i] é o tamanho no fio)
+static inline void batch_add_data(int sockfd, PacketBatch *b, uint32_t session_id, int seq_num,
+                                  unsigned int checksum, const unsigned char *payload, int len,
+                                  const struct sockaddr_in *addr, socklen_t addr_len)
+{
+    if (b->count == IO_BATCH) batch_flush(sockfd, b);
+    wire_encode_header(b->bufs[b->count], PKT_DATA, len, seq_num, checksum, session_id);
+    b->data[b->count] = b->bufs[b->count];
+    b->lens[b->count] = WIRE_HEADER_LEN + len;
+    b->payload[b->count] = payload;
+    b->payload_lens[b->count] = len;
+    b->addrs[b->count] = *addr;
+    b->addr_lens[b->count] = addr_len;
+    b->count++;
+}
+
+#ifdef __linux__
+// Recepção com GRO: cada mensagem pode trazer vários segmentos coalescidos,
+// todos do tamanho informado no cmsg UDP_GRO (o último pode ser menor)
+static inline int batch_recv_gro(int sockfd, PacketBatch *b)
+{
+    for (int i = 0; i < GRO_MSGS; i++) {
+        b->iov[i].iov_base = b->gro_buf + (size_t)i * GRO_BUF_LEN;
+        b->iov[i].iov_len = GRO_BUF_LEN;
+        memset(&b->msgs[i].msg_hdr, 0, sizeof(b->msgs[i].msg_hdr));
+        b->msgs[i].msg_hdr.msg_name = &b->addrs[i];
+        b->msgs[i].msg_hdr.msg_namelen = sizeof(b->addrs[i]);
+        b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+        b->msgs[i].msg_hdr.msg_iovlen = 1;
+        b->msgs[i].msg_hdr.msg_control = b->ctrl[i];
+        b->msgs[i].msg_hdr.msg_controllen = sizeof(b->ctrl[i]);
+    }
+    io_count(&io_stats.recv_calls);
+    int n = recvmmsg(sockfd, b->msgs, GRO_MSGS, MSG_WAITFORONE, NULL);
+    if (n < 0) return -1;
+    
+    // Os endereços de origem são copiados à parte: a expansão dos segmentos
+    // reescreve addrs a partir do início
+    struct sockaddr_in from[GRO_MSGS];
+    socklen_t from_len[GRO_MSGS];
+    for (int m = 0; m < n; m++) {
+        from[m] = b->addrs[m];
+        from_len[m] = b->msgs[m].msg_hdr.msg_namelen;
+    }
+    
+    for (int m = 0; m < n; m++) {
+        int total = (int)b->msgs[m].msg_len;
+        int seg = total;
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&b->msgs[m].msg_hdr); cm;
+             cm = CMSG_NXTHDR(&b->msgs[m].msg_hdr, cm)) {
+            if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                int gso_size;
+                memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+                if (gso_size > 0) seg = gso_size;
+            }
+        }
+        unsigned char *base = (unsigned char*)b->iov[m].iov_base;
+        for (int off = 0; off < total && b->count < IO_RECV_MAX; off += seg) {
+            b->data[b->count] = base + off;
+            b->lens[b->count] = (total - off < seg) ? total - off : seg;
+            b->addrs[b->count] = from[m];
+            b->addr_lens[b->count] = from_len[m];
+            b->count++;
+        }
+    }
+    return b->count;
+}
+#endif
+
+// Recebe até IO_BATCH datagramas: bloqueia (respeitando SO_RCVTIMEO) só até
+// o primeiro e leva junto os que já estão na fila. Retorna quantos chegaram
+// ou -1 com errno, como recvfrom
+static inline int batch_recv(int sockfd, PacketBatch *b)
+{
+    b->count = 0;
+#ifdef __linux__
+    if (b->gro_buf) return batch_recv_gro(sockfd, b);
+    
+    for (int i = 0; i < IO_BATCH; i++) {
+        b->iov[i].iov_base = b->bufs[i];
+        b->iov[i].iov_len = WIRE_MAX_LEN;
+        memset(&b->msgs[i].msg_hdr, 0, sizeof(b->msgs[i].msg_hdr));
+        b->msgs[i].msg_hdr.msg_name = &b->addrs[i];
+        b->msgs[i].msg_hdr.msg_namelen = sizeof(b->addrs[i]);
+        b->msgs[i].msg_hdr.msg_iov = &b->iov[i];
+        b->msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    io_count(&io_stats.recv_calls);
+    int n = recvmmsg(sockfd, b->msgs, IO_BATCH, MSG_WAITFORONE, NULL);
+    if (n < 0) return -1;
+    for (int i = 0; i < n; i++) {
+        b->data[i] = b->bufs[i];
+        b->lens[i] = (int)b->msgs[i].msg_len;
+        b->addr_lens[i] = b->msgs[i].msg_hdr.msg_namelen;
+    }
+    b->count = n;
+#else
+    b->addr_lens[0] = sizeof(b->addrs[0]);
+    io_count(&io_stats.recv_calls);
+    ssize_t n = recvfrom(sockfd, b->bufs[0], WIRE_MAX_LEN, 0,
+                         (struct sockaddr*)&b->addrs[0], &b->addr_lens[0]);
+    if (n < 0) return -1;
+    b->data[0] = b->bufs[0];
+    b->lens[0] = (int)n;
+    b->count = 1;
+#endif
+    return b->count;
+}
+
+// Decodifica o i-ésimo datagrama recebido; -1 se for inválido
+static inline int batch_packet(const PacketBatch *b, int i, Packet *pkt)
+{
+    return packet_decode(b->data[i], b->lens[i], pkt);
+}
+
+#endif
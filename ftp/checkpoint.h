@@ -0,0 +1,137 @@
+/*
+    Checkpoint de transferência para retomada
+    Compartilhado pelos motores Stop and Wait e Sliding Window
+
+    O receptor mantém ao lado do arquivo parcial um sidecar "<arquivo>.ckpt":
+        - base: os pacotes [0, base) já estão no arquivo
+        - hash rolante dos CRCs desses pacotes, na ordem do seq
+        - bitmap (e CRCs) do que já chegou fora de ordem acima de base
+    Numa nova tentativa a requisição leva o ponto de retomada e o hash, e o
+    remetente, que lê o próprio arquivo localmente, confere o hash antes de
+    pular os pacotes já entregues: se o arquivo de origem mudou, a retomada é
+    recusada e a transferência recomeça do zero.
+
+    O sidecar é regravado a cada CHECKPOINT_INTERVAL pacotes e quando a
+    transferência para por timeout; os dados são sincronizados (fsync) antes,
+    então um checkpoint nunca aponta para blocos que ainda não estão no disco.
+*/
+#ifndef FTP_CHECKPOINT_H
+#define FTP_CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "protocol.h"
+#include "checksum.h"
+
+#define CHECKPOINT_BITS 256             // Janela fora de ordem registrada (>= MAX_WINDOW)
+#define CHECKPOINT_INTERVAL 4096        // Pacotes entre gravações (4 MB)
+#define CHECKPOINT_MAGIC "FCK1"
+
+// Mensagem de ERROR do remetente quando o hash do checkpoint não confere
+#define RESUME_MISMATCH_MSG "Checkpoint divergente do arquivo de origem"
+
+typedef struct {
+    char magic[4];
+    int32_t base;                           // Pacotes [0, base) já no arquivo
+    uint32_t prefix_hash;                   // Hash rolante dos CRCs de [0, base)
+    uint64_t bits[CHECKPOINT_BITS / 64];    // Bit i: pacote base + i já no arquivo
+    uint32_t crcs[CHECKPOINT_BITS];         // CRC dos pacotes marcados em bits
+} Checkpoint;
+
+static inline uint32_t resume_hash_init(void)
+{
+    return 2166136261u;
+}
+
+// Acrescenta o CRC do próximo pacote em ordem ao hash (FNV-1a por bloco)
+static inline uint32_t resume_hash_step(uint32_t hash, uint32_t block_crc)
+{
+    return (hash ^ block_crc) * 16777619u;
+}
+
+// Hash dos pacotes [0, packets) do arquivo, calculado pelo remetente;
+// retorna 0 com *hash preenchido, -1 se o arquivo for menor que o prefixo
+static inline int resume_hash_file(int fd, int packets, uint32_t *hash)
+{
+    char block[BUFLEN];
+    uint32_t h = resume_hash_init();
+    for (int seq = 0; seq < packets; seq++) {
+        ssize_t n = pread(fd, block, BUFLEN, (off_t)seq * BUFLEN);
+        if (n <= 0) return -1;
+        h = resume_hash_step(h, calculate_checksum(block, (int)n));
+    }
+    *hash = h;
+    return 0;
+}
+
+static inline void checkpoint_path(char *path, size_t size, const char *data_path)
+{
+    snprintf(path, size, "%s.ckpt", data_path);
+}
+
+// Lê o checkpoint de data_path; -1 se não houver ou se não bater com o arquivo
+static inline int checkpoint_load(const char *data_path, Checkpoint *ck)
+{
+    char path[320];
+    checkpoint_path(path, sizeof(path), data_path);
+
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return -1;
+    ssize_t n = read(fd, ck, sizeof(*ck));
+    close(fd);
+    if (n != (ssize_t)sizeof(*ck) || memcmp(ck->magic, CHECKPOINT_MAGIC, 4) != 0 ||
+        ck->base < 0) {
+        return -1;
+    }
+
+    // O arquivo parcial precisa conter ao menos o prefixo registrado
+    struct stat st;
+    if (stat(data_path, &st) == -1) return -1;
+    if (ck->base > 0 && st.st_size <= (off_t)(ck->base - 1) * BUFLEN) return -1;
+    return 0;
+}
+
+// Grava o checkpoint de forma atômica (arquivo temporário + rename), depois
+// de sincronizar os dados já escritos em data_fd
+static inline int checkpoint_save(const char *data_path, int data_fd, const Checkpoint *ck)
+{
+    char path[320], tmp[330];
+    checkpoint_path(path, sizeof(path), data_path);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    if (fsync(data_fd) == -1) return -1;
+
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) return -1;
+    Checkpoint out = *ck;
+    memcpy(out.magic, CHECKPOINT_MAGIC, 4);
+    ssize_t n = write(fd, &out, sizeof(out));
+    close(fd);
+    if (n != (ssize_t)sizeof(out) || rename(tmp, path) == -1) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+static inline void checkpoint_remove(const char *data_path)
+{
+    char path[320];
+    checkpoint_path(path, sizeof(path), data_path);
+    unlink(path);
+}
+
+// Checkpoint de um receptor sequencial (Stop and Wait): só base e hash
+static inline void checkpoint_sequential(Checkpoint *ck, int base, uint32_t prefix_hash)
+{
+    memset(ck, 0, sizeof(*ck));
+    ck->base = base;
+    ck->prefix_hash = prefix_hash;
+}
+
+#endif
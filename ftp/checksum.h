@@ -0,0 +1,273 @@
+/*
+    CRC32 (IEEE 802.3, polinômio refletido 0xEDB88320) com seleção em tempo de execução
+    Compartilhado pelos motores Stop and Wait e Sliding Window
+
+    Implementações:
+      - reference: bit a bit (8 iterações por byte), versão original
+      - slice8:    tabelas slicing-by-8 (8 bytes por iteração)
+      - pclmul:    dobramento com PCLMULQDQ (x86-64 com PCLMUL + SSE4.1)
+      - armv8:     instruções CRC32 do ARMv8 (aarch64 compilado com +crc)
+
+    A instrução crc32 do SSE4.2 calcula CRC32C (Castagnoli), que não é o
+    polinômio do protocolo, por isso o caminho x86 usa PCLMULQDQ.
+
+    Todas as funções seguem a convenção do zlib: crc32_xxx(0, buf, len) calcula
+    o CRC do buffer e o resultado pode ser passado de volta para continuar.
+    FTP_CRC32_IMPL=<nome> força uma implementação (útil para depuração).
+*/
+#ifndef FTP_CHECKSUM_H
+#define FTP_CHECKSUM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC32_HAVE_PCLMUL 1
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32_HAVE_ARMV8 1
+#endif
+
+typedef uint32_t (*crc32_fn)(uint32_t crc, const unsigned char *buf, size_t len);
+
+// Versão de referência (bit a bit)
+static inline uint32_t crc32_reference(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int j = 0; j < 8; j++) {
+            if (crc & 1)
+                crc = (crc >> 1) ^ 0xEDB88320;
+            else
+                crc >>= 1;
+        }
+    }
+    return ~crc;
+}
+
+// Tabelas slicing-by-8: table[k][b] = CRC de b seguido de k bytes zero
+typedef struct {
+    uint32_t table[8][256];
+} Crc32Tables;
+
+static inline const Crc32Tables *crc32_tables()
+{
+    static const Crc32Tables *tables = []() {
+        static Crc32Tables t;
+        for (uint32_t b = 0; b < 256; b++) {
+            uint32_t crc = b;
+            for (int j = 0; j < 8; j++)
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            t.table[0][b] = crc;
+        }
+        for (uint32_t b = 0; b < 256; b++)
+            for (int k = 1; k < 8; k++)
+                t.table[k][b] = (t.table[k - 1][b] >> 8) ^ t.table[0][t.table[k - 1][b] & 0xFF];
+        return &t;
+    }();
+    return tables;
+}
+
+static inline uint32_t crc32_slice8(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    const uint32_t (*t)[256] = crc32_tables()->table;
+    crc = ~crc;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    while (len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, buf, 4);
+        memcpy(&hi, buf + 4, 4);
+        lo ^= crc;
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+              t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+              t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+              t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        buf += 8;
+        len -= 8;
+    }
+#endif
+    while (len--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xFF];
+    return ~crc;
+}
+
+#ifdef CRC32_HAVE_PCLMUL
+// Dobramento de 4x128 bits com multiplicação sem carry e redução de Barrett
+// ("Fast CRC Computation for Generic Polynomials Using PCLMULQDQ", Intel).
+// Processa len múltiplo de 16 e >= 64; recebe e devolve o estado interno (~crc)
+__attribute__((target("pclmul,sse4.1")))
+static inline uint32_t crc32_pclmul_fold(const unsigned char *buf, size_t len, uint32_t crc)
+{
+    alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+    buf += 64;
+    len -= 64;
+
+    // Quatro dobras em paralelo a cada 64 bytes
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(buf + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(buf + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(buf + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(buf + 0x30)));
+        buf += 64;
+        len -= 64;
+    }
+
+    // Reduz os quatro acumuladores a 128 bits
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Blocos restantes de 16 bytes
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Redução de Barrett para 32 bits
+    x0 = _mm_load_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static inline uint32_t crc32_pclmul(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    if (len >= 64) {
+        size_t chunk = len & ~(size_t)15;
+        crc = ~crc32_pclmul_fold(buf, chunk, ~crc);
+        buf += chunk;
+        len -= chunk;
+    }
+    return crc32_slice8(crc, buf, len);
+}
+
+static inline int crc32_pclmul_available()
+{
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+#endif
+
+#ifdef CRC32_HAVE_ARMV8
+static inline uint32_t crc32_armv8(uint32_t crc, const unsigned char *buf, size_t len)
+{
+    crc = ~crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, buf, 8);
+        crc = __crc32d(crc, v);
+        buf += 8;
+        len -= 8;
+    }
+    while (len--)
+        crc = __crc32b(crc, *buf++);
+    return ~crc;
+}
+#endif
+
+// Tabela de implementações (usada pela seleção e pelo benchmark)
+typedef struct {
+    const char *name;
+    crc32_fn fn;
+    int available;
+} Crc32Impl;
+
+static inline const Crc32Impl *crc32_impls(int *count)
+{
+    static const Crc32Impl impls[] = {
+        { "reference", crc32_reference, 1 },
+        { "slice8",    crc32_slice8,    1 },
+#ifdef CRC32_HAVE_PCLMUL
+        { "pclmul",    crc32_pclmul,    crc32_pclmul_available() },
+#endif
+#ifdef CRC32_HAVE_ARMV8
+        { "armv8",     crc32_armv8,     1 },
+#endif
+    };
+    *count = (int)(sizeof(impls) / sizeof(impls[0]));
+    return impls;
+}
+
+// Escolhe a implementação mais rápida disponível (última da tabela),
+// ou a indicada em FTP_CRC32_IMPL
+static inline const Crc32Impl *crc32_selected()
+{
+    static const Crc32Impl *selected = []() {
+        int count;
+        const Crc32Impl *impls = crc32_impls(&count);
+        const Crc32Impl *best = &impls[0];
+        const char *forced = getenv("FTP_CRC32_IMPL");
+        for (int i = 0; i < count; i++) {
+            if (!impls[i].available) continue;
+            if (forced && strcmp(forced, impls[i].name) == 0) return &impls[i];
+            best = &impls[i];
+        }
+        return best;
+    }();
+    return selected;
+}
+
+static inline uint32_t crc32_update(uint32_t crc, const void *buf, size_t len)
+{
+    return crc32_selected()->fn(crc, (const unsigned char*)buf, len);
+}
+
+// Calcular CRC32 (checksum) de um bloco de dados
+static inline unsigned int calculate_checksum(const char *data, int len)
+{
+    return crc32_update(0, data, len > 0 ? (size_t)len : 0);
+}
+
+#endif
@@ -0,0 +1,335 @@
+/*
+    Log assíncrono para o caminho dos pacotes
+    Compartilhado pelos clientes e servidores dos dois motores
+
+    Um printf() síncrono para o terminal custa mais que o envio do próprio
+    pacote. Com LOG() o produtor só copia um registro binário de tamanho fixo
+    (ponteiro do formato + argumentos crus) para um anel da própria thread:
+    sem lock, sem formatação e sem syscall. Uma thread de fundo drena os anéis,
+    formata com snprintf e escreve em stdout em lotes.
+
+    Cada thread reserva um anel no primeiro LOG() e o devolve ao terminar
+    (destrutor de pthread_key). Anel cheio descarta o registro em vez de
+    bloquear; o total descartado é reportado pela thread de fundo.
+
+    Níveis: LOG_ERROR < LOG_WARN < LOG_INFO < LOG_PACKET. LOG_PACKET é o
+    tráfego normal por pacote (enviado, ACK, escrito) e fica desligado no
+    modo de vazão (sliding-window) a menos que se passe --verbose.
+
+    Restrições: formato literal, no máximo LOG_MAX_ARGS conversões, sem '*'
+    em largura/precisão; strings de %s são copiadas (até LOG_STR_BYTES no
+    total por registro).
+*/
+#ifndef FTP_LOG_H
+#define FTP_LOG_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define LOG_ERROR 0
+#define LOG_WARN 1
+#define LOG_INFO 2
+#define LOG_PACKET 3
+
+#define LOG_MAX_ARGS 6
+#define LOG_STR_BYTES 64
+#define LOG_RING_SIZE 4096      // Registros por anel (potência de 2)
+#define LOG_MAX_RINGS 256       // Threads registradas ao mesmo tempo
+#define LOG_IDLE_US 10000       // Espera da thread de fundo sem registros
+
+#define LOG_RING_FREE 0
+#define LOG_RING_OWNED 1
+#define LOG_RING_RELEASED 2     // Thread terminou; liberado quando esvaziar
+
+typedef union {
+    long long i;
+    double d;
+} LogArg;
+
+typedef struct {
+    const char *fmt;
+    LogArg args[LOG_MAX_ARGS];
+    unsigned char nargs;
+    unsigned char str_len;
+    char strs[LOG_STR_BYTES];   // Cópias das strings de %s, terminadas em '\0'
+} LogRecord;
+
+typedef struct {
+    LogRecord *records;
+    unsigned head;              // Próximo a escrever (só o produtor altera)
+    unsigned tail;              // Próximo a formatar (só a thread de fundo altera)
+    int state;                  // LOG_RING_*
+} LogRing;
+
+static int log_level = LOG_INFO;
+static int log_running = 0;
+static LogRing log_rings[LOG_MAX_RINGS];
+static pthread_key_t log_key;
+static __thread LogRing *log_my_ring = NULL;
+static unsigned long long log_dropped = 0;
+
+#define LOG(level, ...) \
+    do { if ((level) <= log_level) log_write(__VA_ARGS__); } while (0)
+
+// Destrutor da pthread_key: a thread acabou, a de fundo libera o anel ao esvaziar
+static inline void log_ring_release(void *arg)
+{
+    __atomic_store_n(&((LogRing *)arg)->state, LOG_RING_RELEASED, __ATOMIC_RELEASE);
+}
+
+// Anel da thread atual (reserva um livre no primeiro uso); NULL se não houver
+static inline LogRing *log_ring_get(void)
+{
+    if (log_my_ring) return log_my_ring;
+
+    for (int i = 0; i < LOG_MAX_RINGS; i++) {
+        LogRing *ring = &log_rings[i];
+        int expected = LOG_RING_FREE;
+        if (!__atomic_compare_exchange_n(&ring->state, &expected, LOG_RING_OWNED, 0,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            continue;
+        }
+        if (!ring->records) {
+            ring->records = (LogRecord *)malloc(LOG_RING_SIZE * sizeof(LogRecord));
+            if (!ring->records) {
+                __atomic_store_n(&ring->state, LOG_RING_FREE, __ATOMIC_RELEASE);
+                return NULL;
+            }
+        }
+        pthread_setspecific(log_key, ring);
+        log_my_ring = ring;
+        return ring;
+    }
+    return NULL;
+}
+
+// Pula flags, largura e precisão de uma conversão; devolve o modificador de tamanho
+// (0 = int, 1 = long, 2 = long long) e deixa *p na letra da conversão
+static inline int log_parse_spec(const char **p)
+{
+    const char *s = *p;
+    while (*s && strchr("-+ #0123456789.", *s)) s++;
+    int size = 0;
+    if (*s == 'h') {
+        while (*s == 'h') s++;
+    } else if (*s == 'z') {
+        size = 1;
+        s++;
+    } else {
+        while (*s == 'l' && size < 2) {
+            size++;
+            s++;
+        }
+    }
+    *p = s;
+    return size;
+}
+
+// Produtor: copia formato e argumentos crus para o anel da thread
+static inline void log_write(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static inline void log_write(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+
+    // Sem a thread de fundo (ou sem anel livre): escreve direto
+    LogRing *ring = log_running ? log_ring_get() : NULL;
+    if (!ring) {
+        vprintf(fmt, ap);
+        va_end(ap);
+        return;
+    }
+
+    unsigned head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE) {
+        __atomic_fetch_add(&log_dropped, 1, __ATOMIC_RELAXED);
+        va_end(ap);
+        return;
+    }
+
+    LogRecord *rec = &ring->records[head & (LOG_RING_SIZE - 1)];
+    rec->fmt = fmt;
+    rec->nargs = 0;
+    rec->str_len = 0;
+
+    for (const char *p = fmt; *p && rec->nargs < LOG_MAX_ARGS; p++) {
+        if (*p != '%') continue;
+        if (*++p == '%') continue;
+
+        int size = log_parse_spec(&p);
+        LogArg *arg = &rec->args[rec->nargs++];
+        switch (*p) {
+        case 'd': case 'i':
+            arg->i = size == 2 ? va_arg(ap, long long) : size == 1 ? va_arg(ap, long) : va_arg(ap, int);
+            break;
+        case 'u': case 'x': case 'X': case 'o': case 'c':
+            arg->i = size == 2 ? (long long)va_arg(ap, unsigned long long)
+                   : size == 1 ? (long long)va_arg(ap, unsigned long) : (long long)va_arg(ap, unsigned int);
+            break;
+        case 'f': case 'e': case 'g': case 'F': case 'E': case 'G':
+            arg->d = va_arg(ap, double);
+            break;
+        case 'p':
+            arg->i = (long long)(intptr_t)va_arg(ap, void *);
+            break;
+        case 's': {
+            const char *s = va_arg(ap, const char *);
+            size_t room = LOG_STR_BYTES - rec->str_len;
+            size_t len = room > 0 ? strnlen(s, room - 1) : 0;
+            arg->i = rec->str_len;
+            if (room > 0) {
+                memcpy(rec->strs + rec->str_len, s, len);
+                rec->strs[rec->str_len + len] = '\0';
+                rec->str_len += len + 1;
+            } else {
+                arg->i = LOG_STR_BYTES - 1;   // Sem espaço: string vazia
+            }
+            break;
+        }
+        default:
+            rec->nargs--;
+            if (!*p) p--;
+            break;
+        }
+    }
+    va_end(ap);
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+// Thread de fundo: formata um registro em out (retorna o tamanho escrito)
+static inline int log_format(const LogRecord *rec, char *out, int cap)
+{
+    int len = 0;
+    int n = 0;
+    for (const char *p = rec->fmt; *p && len < cap - 1; p++) {
+        if (*p != '%') {
+            out[len++] = *p;
+            continue;
+        }
+        const char *start = p++;
+        if (*p == '%') {
+            out[len++] = '%';
+            continue;
+        }
+        int size = log_parse_spec(&p);
+        if (!*p || n >= rec->nargs) break;
+
+        char spec[24];
+        int spec_len = (int)(p - start) + 1;
+        if (spec_len >= (int)sizeof(spec)) break;
+        memcpy(spec, start, spec_len);
+        spec[spec_len] = '\0';
+
+        const LogArg *arg = &rec->args[n++];
+        int room = cap - len;
+        int w;
+        switch (*p) {
+        case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+            w = size == 2 ? snprintf(out + len, room, spec, arg->i)
+              : size == 1 ? snprintf(out + len, room, spec, (long)arg->i)
+                          : snprintf(out + len, room, spec, (int)arg->i);
+            break;
+        case 'f': case 'e': case 'g': case 'F': case 'E': case 'G':
+            w = snprintf(out + len, room, spec, arg->d);
+            break;
+        case 'p':
+            w = snprintf(out + len, room, spec, (void *)(intptr_t)arg->i);
+            break;
+        case 's':
+            w = snprintf(out + len, room, spec, rec->strs + arg->i);
+            break;
+        default:
+            w = 0;
+            break;
+        }
+        len += w < room ? w : room - 1;
+    }
+    return len;
+}
+
+// Drena todos os anéis uma vez; retorna quantos registros foram escritos
+static inline int log_drain(char *buf, int cap)
+{
+    int total = 0;
+    for (int i = 0; i < LOG_MAX_RINGS; i++) {
+        LogRing *ring = &log_rings[i];
+        int state = __atomic_load_n(&ring->state, __ATOMIC_ACQUIRE);
+        if (state == LOG_RING_FREE) continue;
+
+        unsigned head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned tail = ring->tail;
+        int len = 0;
+        for (; tail != head; tail++) {
+            if (len > cap - 512) {
+                fwrite(buf, 1, len, stdout);
+                len = 0;
+            }
+            len += log_format(&ring->records[tail & (LOG_RING_SIZE - 1)], buf + len, cap - len);
+            total++;
+        }
+        if (len > 0) fwrite(buf, 1, len, stdout);
+        fflush(stdout);
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        if (state == LOG_RING_RELEASED) {
+            __atomic_store_n(&ring->state, LOG_RING_FREE, __ATOMIC_RELEASE);
+        }
+    }
+    return total;
+}
+
+static inline void *log_thread(void *arg)
+{
+    (void)arg;
+    static char buf[1 << 16];
+    unsigned long long reported = 0;
+    while (1) {
+        int written = log_drain(buf, sizeof(buf));
+
+        unsigned long long dropped = __atomic_load_n(&log_dropped, __ATOMIC_RELAXED);
+        if (dropped != reported) {
+            printf("⚠️  Log: %llu mensagens descartadas (anel cheio)\n", dropped - reported);
+            fflush(stdout);
+            reported = dropped;
+        }
+        if (written == 0) usleep(LOG_IDLE_US);
+    }
+    return NULL;
+}
+
+// Liga o log assíncrono com o nível dado (chamar no início do main)
+static inline void log_start(int level)
+{
+    log_level = level;
+    pthread_key_create(&log_key, log_ring_release);
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, log_thread, NULL) != 0) return;
+    pthread_detach(tid);
+    log_running = 1;
+}
+
+// Espera a thread de fundo escrever tudo o que já foi registrado (até ~1 s),
+// para a saída síncrona seguinte não passar na frente dos registros
+static inline void log_flush(void)
+{
+    for (int tries = 0; log_running && tries < 1000; tries++) {
+        int pending = 0;
+        for (int i = 0; i < LOG_MAX_RINGS && !pending; i++) {
+            LogRing *ring = &log_rings[i];
+            if (__atomic_load_n(&ring->state, __ATOMIC_ACQUIRE) == LOG_RING_FREE) continue;
+            pending = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) !=
+                      __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        }
+        if (!pending) return;
+        usleep(1000);
+    }
+}
+
+#endif
@@ -0,0 +1,340 @@
+/*
+    Protocolo FTP sobre UDP - formato de pacote no fio
+    Compartilhado pelos motores Stop and Wait e Sliding Window
+
+    Cabeçalho binário versionado (16 bytes, ordem de rede):
+        0   uint8   versão (PROTO_VERSION)
+        1   uint8   tipo (PKT_*)
+        2   uint16  tamanho do payload
+        4   uint32  número de sequência
+        8   uint32  checksum (CRC32 do payload de dados)
+       12   uint32  id da sessão (escolhido pelo cliente na requisição e
+                     repetido em todos os pacotes da transferência)
+       16   payload: data_len bytes de dados, ou o nome do arquivo nas
+                     requisições; END não leva payload
+
+    Bloco opcional nas requisições, logo após o nome do arquivo e um byte 0:
+        uint32  primeiro pacote (download em paralelo ou retomada)
+        uint32  fim da faixa, exclusivo (0 = até o fim do arquivo)
+        uint32  hash do prefixo já recebido (só na retomada, ver ../checkpoint.h)
+    Os pacotes DATA usam o número absoluto do bloco, então o receptor escreve
+    cada um em seq * BUFLEN qualquer que seja a faixa. No upload com retomada
+    o ACK da requisição devolve o ponto de retomada (cum_ack + SACK) e o hash
+    do prefixo no campo de checksum.
+
+    ACK (tamanho do payload = 0, seguido de bloco fixo de 18 bytes):
+       16   uint32  cum_ack: todos os seq < cum_ack foram recebidos
+       20   uint64  sack_bits: bit i indica que cum_ack + 1 + i foi recebido
+       28   uint16  rwnd: o receptor aceita os seq < cum_ack + rwnd (0 = sem
+                     anúncio; ACKs de 12 bytes também são aceitos, sem ele)
+       30   uint32  total de pacotes que o receptor reconstruiu pela FEC; a
+                     redundância do remetente se adapta a ele (ACKs sem o
+                     campo valem 0)
+
+    FEC (paridade de um bloco de pacotes DATA, ver sliding-window/fec.h):
+    seq = primeiro pacote do bloco, checksum = CRC32 da paridade e, entre o
+    cabeçalho e o payload, um bloco fixo de 4 bytes:
+       16   uint8   k: pacotes de dados no bloco
+       17   uint8   índice da paridade (linha do código)
+       18   uint16  tamanho do último pacote do bloco (os demais têm BUFLEN)
+       20   payload: paridade (BUFLEN bytes, ou o tamanho do único pacote)
+
+    END (seq = fim da faixa) sai quando todos os pacotes já foram
+    confirmados e é confirmado por um ACK com o mesmo seq. No Sliding Window
+    o remetente o repete a cada RTO (com backoff) até esse ACK, e o servidor
+    continua respondendo ENDs repetidos de um upload por um tempo depois de
+    concluí-lo, já que a própria resposta pode se perder.
+
+    STAT_REQUEST só consulta o tamanho do arquivo: a resposta é um ACK com
+    cum_ack = total de pacotes e sack_bits = tamanho em bytes (ou ERROR).
+
+    Upload por delta (ver sliding-window/delta.h): SIGNATURE_REQUEST é servido
+    como um download da assinatura de received_<nome>, e DELTA_REQUEST como
+    um upload do delta; o ACK do END só vem depois que o servidor remontou e
+    conferiu o arquivo (ERROR se o delta não puder ser aplicado).
+
+    O DOWNLOAD_REQUEST não tem resposta própria: os primeiros pacotes DATA
+    já são a resposta, e a porta de onde vêm é a da sessão, para onde vão
+    os ACKs.
+
+    O id da sessão permite que várias transferências dividam a mesma porta
+    (modo reactor do servidor) e que pacotes atrasados de uma transferência
+    anterior sejam descartados.
+*/
+#ifndef FTP_PROTOCOL_H
+#define FTP_PROTOCOL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define BUFLEN 1024
+
+#define PROTO_VERSION 3
+#define WIRE_HEADER_LEN 16
+#define WIRE_ACK_LEN 12        // cum_ack + sack_bits
+#define WIRE_RWND_LEN 2        // janela anunciada, logo após o bloco do ACK
+#define WIRE_RECOVERED_LEN 4   // reconstruídos pela FEC, logo após a janela anunciada
+#define WIRE_RANGE_LEN 8       // primeiro pacote + fim da faixa
+#define WIRE_RESUME_LEN 4      // hash do prefixo (retomada)
+#define WIRE_FEC_LEN 4         // k + índice + tamanho do último pacote
+#define WIRE_MAX_LEN (WIRE_HEADER_LEN + WIRE_FEC_LEN + BUFLEN)
+#define SACK_BITS 64
+
+// Tipos de pacotes
+#define PKT_UPLOAD_REQUEST 1
+#define PKT_DOWNLOAD_REQUEST 2
+#define PKT_DATA 3
+#define PKT_ACK 4
+#define PKT_END 5
+#define PKT_ERROR 6
+#define PKT_STAT_REQUEST 7
+#define PKT_SIGNATURE_REQUEST 8
+#define PKT_DELTA_REQUEST 9
+#define PKT_FEC 10
+
+// Representação em memória (o fio só carrega os campos usados pelo tipo)
+typedef struct {
+    int type;
+    int seq_num;
+    int data_len;
+    char filename[256];
+    char data[BUFLEN];
+    unsigned int checksum;
+    int cum_ack;               // ACK: próximo seq esperado em ordem
+    uint64_t sack_bits;        // ACK: recebidos acima de cum_ack
+    int rwnd;                  // ACK: pacotes a partir de cum_ack que o receptor aceita (0: sem anúncio)
+    uint32_t fec_recovered;    // ACK: pacotes que o receptor reconstruiu pela FEC
+    uint32_t session_id;       // Sessão da transferência
+    int range_first;           // DOWNLOAD_REQUEST: primeiro pacote da faixa
+    int range_end;             // DOWNLOAD_REQUEST: fim da faixa (0 = até o fim)
+    int resume;                // Requisição: retomar a partir de um checkpoint
+    uint32_t resume_hash;      // DOWNLOAD_REQUEST: hash dos pacotes [0, range_first)
+    int fec_k;                 // FEC: pacotes de dados no bloco
+    int fec_index;             // FEC: linha do código desta paridade
+    int fec_last_len;          // FEC: tamanho do último pacote do bloco
+} Packet;
+
+static inline int is_request(int type)
+{
+    return type == PKT_UPLOAD_REQUEST || type == PKT_DOWNLOAD_REQUEST || type == PKT_STAT_REQUEST ||
+           type == PKT_SIGNATURE_REQUEST || type == PKT_DELTA_REQUEST;
+}
+
+// Escreve só o cabeçalho (WIRE_HEADER_LEN bytes); o payload de payload_len
+// bytes vai logo depois no datagrama, copiado ou em outro iovec
+static inline void wire_encode_header(unsigned char *buf, int type, int payload_len, int seq_num,
+                                      unsigned int checksum, uint32_t session_id)
+{
+    uint16_t len_n = htons((uint16_t)payload_len);
+    uint32_t seq_n = htonl((uint32_t)seq_num);
+    uint32_t crc_n = htonl((uint32_t)checksum);
+    uint32_t sid_n = htonl(session_id);
+
+    buf[0] = PROTO_VERSION;
+    buf[1] = (unsigned char)type;
+    memcpy(buf + 2, &len_n, 2);
+    memcpy(buf + 4, &seq_n, 4);
+    memcpy(buf + 8, &crc_n, 4);
+    memcpy(buf + 12, &sid_n, 4);
+}
+
+// Serializa o pacote em buf (mínimo WIRE_MAX_LEN bytes); retorna o tamanho no fio
+static inline int packet_encode(const Packet *pkt, unsigned char *buf)
+{
+    const char *payload = pkt->data;
+    int len = 0;
+
+    if (is_request(pkt->type)) {
+        len = (int)strnlen(pkt->filename, sizeof(pkt->filename) - 1);
+        memcpy(buf + WIRE_HEADER_LEN, pkt->filename, len);
+
+        // Bloco só quando pedido: requisições do arquivo todo não mudam no fio
+        if (pkt->range_first > 0 || pkt->range_end > 0 || pkt->resume) {
+            uint32_t first_n = htonl((uint32_t)pkt->range_first);
+            uint32_t end_n = htonl((uint32_t)pkt->range_end);
+            buf[WIRE_HEADER_LEN + len] = 0;
+            memcpy(buf + WIRE_HEADER_LEN + len + 1, &first_n, 4);
+            memcpy(buf + WIRE_HEADER_LEN + len + 5, &end_n, 4);
+            len += 1 + WIRE_RANGE_LEN;
+            if (pkt->resume) {
+                uint32_t hash_n = htonl(pkt->resume_hash);
+                memcpy(buf + WIRE_HEADER_LEN + len, &hash_n, 4);
+                len += WIRE_RESUME_LEN;
+            }
+        }
+
+        wire_encode_header(buf, pkt->type, len, pkt->seq_num, pkt->checksum, pkt->session_id);
+        return WIRE_HEADER_LEN + len;
+    } else if (pkt->type == PKT_DATA || pkt->type == PKT_ERROR || pkt->type == PKT_FEC) {
+        len = pkt->data_len;
+        if (len < 0) len = 0;
+        if (len > BUFLEN) len = BUFLEN;
+    }
+
+    if (pkt->type == PKT_FEC) {
+        uint16_t last_n = htons((uint16_t)pkt->fec_last_len);
+        wire_encode_header(buf, pkt->type, len, pkt->seq_num, pkt->checksum, pkt->session_id);
+        buf[WIRE_HEADER_LEN] = (unsigned char)pkt->fec_k;
+        buf[WIRE_HEADER_LEN + 1] = (unsigned char)pkt->fec_index;
+        memcpy(buf + WIRE_HEADER_LEN + 2, &last_n, 2);
+        memcpy(buf + WIRE_HEADER_LEN + WIRE_FEC_LEN, payload, len);
+        return WIRE_HEADER_LEN + WIRE_FEC_LEN + len;
+    }
+
+    wire_encode_header(buf, pkt->type, len, pkt->seq_num, pkt->checksum, pkt->session_id);
+    memcpy(buf + WIRE_HEADER_LEN, payload, len);
+
+    if (pkt->type == PKT_ACK) {
+        uint32_t cum_n = htonl((uint32_t)pkt->cum_ack);
+        uint32_t hi_n = htonl((uint32_t)(pkt->sack_bits >> 32));
+        uint32_t lo_n = htonl((uint32_t)pkt->sack_bits);
+        memcpy(buf + WIRE_HEADER_LEN, &cum_n, 4);
+        memcpy(buf + WIRE_HEADER_LEN + 4, &hi_n, 4);
+        memcpy(buf + WIRE_HEADER_LEN + 8, &lo_n, 4);
+        uint16_t rwnd_n = htons((uint16_t)(pkt->rwnd > 0xFFFF ? 0xFFFF : pkt->rwnd));
+        memcpy(buf + WIRE_HEADER_LEN + WIRE_ACK_LEN, &rwnd_n, 2);
+        uint32_t recovered_n = htonl(pkt->fec_recovered);
+        memcpy(buf + WIRE_HEADER_LEN + WIRE_ACK_LEN + WIRE_RWND_LEN, &recovered_n, 4);
+        return WIRE_HEADER_LEN + WIRE_ACK_LEN + WIRE_RWND_LEN + WIRE_RECOVERED_LEN;
+    }
+
+    return WIRE_HEADER_LEN + len;
+}
+
+// Decodifica len bytes recebidos; retorna -1 se o datagrama for inválido
+static inline int packet_decode(const unsigned char *buf, int len, Packet *pkt)
+{
+    if (len < WIRE_HEADER_LEN || buf[0] != PROTO_VERSION) return -1;
+
+    uint16_t len_n;
+    uint32_t seq_n, crc_n, sid_n;
+    memcpy(&len_n, buf + 2, 2);
+    memcpy(&seq_n, buf + 4, 4);
+    memcpy(&crc_n, buf + 8, 4);
+    memcpy(&sid_n, buf + 12, 4);
+
+    int payload_len = ntohs(len_n);
+    if (payload_len > BUFLEN || len < WIRE_HEADER_LEN + payload_len) return -1;
+
+    pkt->type = buf[1];
+    pkt->seq_num = (int)ntohl(seq_n);
+    pkt->checksum = ntohl(crc_n);
+    pkt->session_id = ntohl(sid_n);
+    pkt->filename[0] = '\0';
+    pkt->range_first = 0;
+    pkt->range_end = 0;
+    pkt->resume = 0;
+    pkt->resume_hash = 0;
+
+    if (pkt->type == PKT_ACK) {
+        if (len < WIRE_HEADER_LEN + WIRE_ACK_LEN) return -1;
+        uint32_t cum_n, hi_n, lo_n;
+        memcpy(&cum_n, buf + WIRE_HEADER_LEN, 4);
+        memcpy(&hi_n, buf + WIRE_HEADER_LEN + 4, 4);
+        memcpy(&lo_n, buf + WIRE_HEADER_LEN + 8, 4);
+        pkt->cum_ack = (int)ntohl(cum_n);
+        pkt->sack_bits = ((uint64_t)ntohl(hi_n) << 32) | ntohl(lo_n);
+        pkt->rwnd = 0;
+        if (len >= WIRE_HEADER_LEN + WIRE_ACK_LEN + WIRE_RWND_LEN) {
+            uint16_t rwnd_n;
+            memcpy(&rwnd_n, buf + WIRE_HEADER_LEN + WIRE_ACK_LEN, 2);
+            pkt->rwnd = ntohs(rwnd_n);
+        }
+        pkt->fec_recovered = 0;
+        if (len >= WIRE_HEADER_LEN + WIRE_ACK_LEN + WIRE_RWND_LEN + WIRE_RECOVERED_LEN) {
+            uint32_t recovered_n;
+            memcpy(&recovered_n, buf + WIRE_HEADER_LEN + WIRE_ACK_LEN + WIRE_RWND_LEN, 4);
+            pkt->fec_recovered = ntohl(recovered_n);
+        }
+        pkt->data_len = 0;
+    } else if (is_request(pkt->type)) {
+        const char *payload = (const char*)buf + WIRE_HEADER_LEN;
+        int name_len = (int)strnlen(payload, payload_len);
+        if (name_len >= (int)sizeof(pkt->filename)) return -1;
+        memcpy(pkt->filename, payload, name_len);
+        pkt->filename[name_len] = '\0';
+        pkt->data_len = 0;
+
+        if (payload_len >= name_len + 1 + WIRE_RANGE_LEN) {
+            uint32_t first_n, end_n;
+            memcpy(&first_n, payload + name_len + 1, 4);
+            memcpy(&end_n, payload + name_len + 5, 4);
+            pkt->range_first = (int)ntohl(first_n);
+            pkt->range_end = (int)ntohl(end_n);
+            if (pkt->range_first < 0 || pkt->range_end < 0) return -1;
+        }
+        if (payload_len >= name_len + 1 + WIRE_RANGE_LEN + WIRE_RESUME_LEN) {
+            uint32_t hash_n;
+            memcpy(&hash_n, payload + name_len + 1 + WIRE_RANGE_LEN, 4);
+            pkt->resume = 1;
+            pkt->resume_hash = ntohl(hash_n);
+        }
+    } else if (pkt->type == PKT_FEC) {
+        if (len < WIRE_HEADER_LEN + WIRE_FEC_LEN + payload_len) return -1;
+        uint16_t last_n;
+        memcpy(&last_n, buf + WIRE_HEADER_LEN + 2, 2);
+        pkt->fec_k = buf[WIRE_HEADER_LEN];
+        pkt->fec_index = buf[WIRE_HEADER_LEN + 1];
+        pkt->fec_last_len = ntohs(last_n);
+        memcpy(pkt->data, buf + WIRE_HEADER_LEN + WIRE_FEC_LEN, payload_len);
+        pkt->data_len = payload_len;
+    } else {
+        memcpy(pkt->data, buf + WIRE_HEADER_LEN, payload_len);
+        if (payload_len < BUFLEN) pkt->data[payload_len] = '\0';
+        pkt->data_len = payload_len;
+    }
+    return 0;
+}
+
+// Syscalls de rede do processo (todas as threads), para o relatório de E/S
+typedef struct {
+    unsigned long long send_calls;
+    unsigned long long recv_calls;
+} IoStats;
+
+static IoStats io_stats;
+
+static inline void io_count(unsigned long long *counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+// Imprime as syscalls desde o instante start, por MB de arquivo transferido
+static inline void io_report(const char *prefix, const IoStats *start, long long bytes)
+{
+    unsigned long long sends = __atomic_load_n(&io_stats.send_calls, __ATOMIC_RELAXED) - start->send_calls;
+    unsigned long long recvs = __atomic_load_n(&io_stats.recv_calls, __ATOMIC_RELAXED) - start->recv_calls;
+    double mb = bytes / (1024.0 * 1024.0);
+    printf("%s📊 E/S: %llu envios + %llu recepções = %.0f syscalls/MB\n",
+           prefix, sends, recvs, mb > 0 ? (sends + recvs) / mb : 0.0);
+}
+
+// sendto com o formato compacto
+static inline ssize_t send_packet(int sockfd, const Packet *pkt,
+                                  const struct sockaddr_in *addr, socklen_t addr_len)
+{
+    unsigned char buf[WIRE_MAX_LEN];
+    int len = packet_encode(pkt, buf);
+    io_count(&io_stats.send_calls);
+    return sendto(sockfd, buf, len, 0, (const struct sockaddr*)addr, addr_len);
+}
+
+// recvfrom com o formato compacto; datagramas inválidos são descartados.
+// Mesmo retorno de recvfrom (-1 com errno em erro/timeout)
+static inline ssize_t recv_packet(int sockfd, Packet *pkt,
+                                  struct sockaddr_in *addr, socklen_t *addr_len)
+{
+    unsigned char buf[WIRE_MAX_LEN];
+    while (1) {
+        ssize_t n = recvfrom(sockfd, buf, sizeof(buf), 0, (struct sockaddr*)addr, addr_len);
+        io_count(&io_stats.recv_calls);
+        if (n < 0) return n;
+        if (packet_decode(buf, (int)n, pkt) == 0) return n;
+    }
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    Estimador de RTT e RTO (RFC 6298)
+    Compartilhado pelos motores Stop and Wait e Sliding Window
+
+    Os instantes vêm de CLOCK_MONOTONIC em nanossegundos: numa LAN o RTT é
+    de dezenas a centenas de microssegundos e o relógio em ms de antes o
+    media como 0. O remetente guarda o instante de envio de cada pacote e
+    chama rtt_sample() com a diferença na chegada do ACK.
+
+    Regra de Karn: só pacotes nunca retransmitidos geram amostra (o ACK de um
+    pacote reenviado não diz a qual transmissão responde). Cada timeout dobra
+    o RTO (rtt_on_timeout) até a próxima amostra válida.
+
+        SRTT   = R, RTTVAR = R/2                          (primeira amostra)
+        RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|
+        SRTT   = 7/8 SRTT + 1/8 R
+        RTO    = SRTT + max(G, 4 RTTVAR), limitado a [mínimo, RTO_MAX_NS]
+
+    O mínimo é escolhido por quem usa: o Stop and Wait só tem o timeout para
+    se recuperar, a janela deslizante tem o RACK e o probe antes dele.
+*/
+#ifndef FTP_RTT_H
+#define FTP_RTT_H
+
+#include <string.h>
+#include <time.h>
+
+#define RTO_INITIAL_NS 1000000000LL     // 1 s antes da primeira amostra
+#define RTO_MAX_NS 60000000000LL        // 60 s
+#define RTO_GRANULARITY_NS 100000LL     // G: folga do timer (100 µs)
+#define RTO_MAX_BACKOFF 10              // Dobras acumuladas no máximo
+
+typedef struct {
+    long long srtt_ns;
+    long long rttvar_ns;
+    long long rto_ns;       // Sem backoff
+    long long min_rto_ns;
+    int backoff;            // Timeouts desde a última amostra
+    int samples;
+} RttEstimator;
+
+// Instante atual em ns (CLOCK_MONOTONIC)
+static inline long long now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Instante de now_ns() para pthread_cond_timedwait (condição com CLOCK_MONOTONIC)
+static inline void ns_to_timespec(long long ns, struct timespec *ts)
+{
+    ts->tv_sec = ns / 1000000000LL;
+    ts->tv_nsec = ns % 1000000000LL;
+}
+
+static inline void rtt_init(RttEstimator *e, long long min_rto_ns)
+{
+    memset(e, 0, sizeof(*e));
+    e->rto_ns = RTO_INITIAL_NS;
+    e->min_rto_ns = min_rto_ns;
+}
+
+// Nova amostra (pacote nunca retransmitido); desfaz o backoff
+static inline void rtt_sample(RttEstimator *e, long long r)
+{
+    if (r < 1) r = 1;
+    if (e->samples == 0) {
+        e->srtt_ns = r;
+        e->rttvar_ns = r / 2;
+    } else {
+        long long err = e->srtt_ns > r ? e->srtt_ns - r : r - e->srtt_ns;
+        e->rttvar_ns = (3 * e->rttvar_ns + err) / 4;
+        e->srtt_ns = (7 * e->srtt_ns + r) / 8;
+    }
+    e->samples++;
+
+    long long var = 4 * e->rttvar_ns;
+    e->rto_ns = e->srtt_ns + (var > RTO_GRANULARITY_NS ? var : RTO_GRANULARITY_NS);
+    if (e->rto_ns < e->min_rto_ns) e->rto_ns = e->min_rto_ns;
+    if (e->rto_ns > RTO_MAX_NS) e->rto_ns = RTO_MAX_NS;
+    e->backoff = 0;
+}
+
+// Timeout: o RTO dobra até a próxima amostra
+static inline void rtt_on_timeout(RttEstimator *e)
+{
+    if (e->backoff < RTO_MAX_BACKOFF) e->backoff++;
+}
+
+// RTO atual com backoff
+static inline long long rtt_rto_ns(const RttEstimator *e)
+{
+    long long rto = e->rto_ns << e->backoff;
+    return rto > RTO_MAX_NS ? RTO_MAX_NS : rto;
+}
+
+// SRTT (antes da primeira amostra vale o RTO inicial)
+static inline long long rtt_srtt_ns(const RttEstimator *e)
+{
+    return e->samples ? e->srtt_ns : RTO_INITIAL_NS;
+}
+
+// SRTT e RTTVAR em segundos (controle de congestionamento, telemetria)
+static inline double rtt_srtt_s(const RttEstimator *e)
+{
+    return rtt_srtt_ns(e) / 1e9;
+}
+
+static inline double rtt_rttvar_s(const RttEstimator *e)
+{
+    return e->rttvar_ns / 1e9;
+}
+
+#endif
@@ -2,8 +2,35 @@
     FTP Client com UDP - Sliding Window
     Suporta upload e download de arquivos
     - Janela deslizante com reenvio seletivo
-    - Checksum CRC32 para integridade
-    - Timeout adaptativo
+    - Checksum CRC32 para integridade (acelerado, ver ../checksum.h)
+    - Formato compacto no fio (ver ../protocol.h)
+    - E/S em lote: rajadas com sendmmsg e recepção com recvmmsg (ver ../batch_io.h)
+    - Offload opcional (--gso): UDP_SEGMENT no envio e UDP_GRO na recepção (Linux)
+    - Timeout adaptativo: RTT em ns com regra de Karn e RTO da RFC 6298 (ver ../rtt.h)
+    - Envio em streaming (memória proporcional à janela, não ao arquivo)
+    - Payload sem cópia: arquivo mapeado e datagramas montados por iovec (ver file_source.h)
+    - Recepção direta: pwrite no offset de cada pacote e bitmap da janela (ver file_sink.h)
+    - Janela dinâmica com controle de congestionamento (--cc reno|cubic|delay)
+    - Download em paralelo (download --streams N): faixas do arquivo em sessões
+      independentes, escritas com pwrite no mesmo arquivo
+    - Retomada: transferência interrompida continua do checkpoint (ver ../checkpoint.h)
+    - Upload por delta (upload --delta): só blocos alterados e referências à
+      versão que o servidor já tem, estilo rsync (ver delta.h)
+    - Log assíncrono (ver ../log.h): por pacote só com --verbose
+    - Retransmissão rápida (RACK) e tail loss probe; o timeout é o último recurso
+      (ver loss_recovery.h)
+    - Pacing do upload: envios espalhados à taxa cwnd/SRTT, limite com
+      --rate <Mbit/s> (ver pacing.h)
+    - Lotes (mput/mget): listas, padrões glob e @arquivo com várias
+      transferências em andamento ao mesmo tempo (--pipeline N) e métricas do
+      caminho herdadas de um arquivo para o outro (ver path_cache.h)
+    - FEC (--fec): paridade XOR/Reed-Solomon por bloco nos uploads, com
+      redundância adaptada à perda medida; downloads com FEC são reconstruídos
+      sem retransmissão (ver fec.h)
+    - Encerramento sem espera fixa: END repetido a cada RTO até o ACK do servidor
+    - Controle de fluxo: os ACKs anunciam o espaço livre do receptor (rwnd) e
+      o upload para em min(cwnd, rwnd), com um pacote de sonda se fechar
+      (ver file_sink.h)
 */
 #include <stdio.h>
 #include <string.h>
@@ -14,49 +41,33 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <math.h>
 #include <pthread.h>
+#include <time.h>
+#include <glob.h>
+
+#include "../protocol.h"
+#include "../checksum.h"
+#include "../batch_io.h"
+#include "../log.h"
+#include "../rtt.h"
+#include "congestion.h"
+#include "loss_recovery.h"
+#include "pacing.h"
+#include "path_cache.h"
+#include "file_source.h"
+#include "file_sink.h"
+#include "fec.h"
+#include "sender.h"
+#include "delta.h"
 
-#define BUFLEN 1024
 #define PORT 9999
 #define INITIAL_TIMEOUT_MS 2000
 #define MAX_RETRIES 5
-#define ALPHA 0.125
-#define BETA 0.25
-#define WINDOW_SIZE 5
-
-//packet types
-#define PKT_UPLOAD_REQUEST 1
-#define PKT_DOWNLOAD_REQUEST 2
-#define PKT_DATA 3
-#define PKT_ACK 4
-#define PKT_END 5
-#define PKT_ERROR 6
-
-typedef struct {
-    int type;
-    int seq_num;
-    int data_len;
-    char filename[256];
-    char data[BUFLEN];
-    unsigned int checksum;
-} Packet;
 
-typedef struct {
-    Packet packets[WINDOW_SIZE];
-    long long send_times[WINDOW_SIZE];
-    int acked[WINDOW_SIZE];
-    int base;
-    int next_seq_num;
-    int total_packets;
-    pthread_mutex_t lock;
-    int sockfd;
-    struct sockaddr_in *server_addr;
-    socklen_t addr_len;
-    int finished;
-    double estimated_rtt;
-    double dev_rtt;
-} SlidingWindow;
+// Algoritmo de controle de congestionamento dos uploads (--cc)
+static const CongestionOps *cc_ops = &cc_algorithms[0];
 
 void die(const char *s)
 {
@@ -64,22 +75,6 @@ void die(const char *s)
     exit(1);
 }
 
-//Checksum CRC32
-unsigned int calculate_checksum(const char *data, int len)
-{
-    unsigned int crc = 0xFFFFFFFF;
-    for (int i = 0; i < len; i++) {
-        crc ^= (unsigned char)data[i];
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1)
-                crc = (crc >> 1) ^ 0xEDB88320;
-            else
-                crc >>= 1;
-        }
-    }
-    return ~crc;
-}
-
 long long get_timestamp_ms()
 {
     struct timeval tv;
@@ -87,103 +82,385 @@ long long get_timestamp_ms()
     return (long long)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
 }
 
-void* thread_receive_acks(void *arg) {
-    SlidingWindow *window = (SlidingWindow*)arg;
+// ACK cumulativo + SACK, janela anunciada e o total reconstruído pela FEC
+// (vai para a porta da thread do servidor)
+void send_ack(int sockfd, uint32_t session_id, int seq_num, int cum_ack, uint64_t sack_bits,
+              int rwnd, uint32_t recovered, struct sockaddr_in *addr, socklen_t addr_len)
+{
     Packet ack;
+    memset(&ack, 0, sizeof(Packet));
+    ack.type = PKT_ACK;
+    ack.session_id = session_id;
+    ack.seq_num = seq_num;
+    ack.cum_ack = cum_ack;
+    ack.sack_bits = sack_bits;
+    ack.rwnd = rwnd;
+    ack.fec_recovered = recovered;
+    
+    send_packet(sockfd, &ack, addr, addr_len);
+}
 
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 100000;
-    setsockopt(window->sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-    while (!window->finished) {
-        memset(&ack, 0, sizeof(Packet));
-
-        int recv_len = recvfrom(window->sockfd, &ack, sizeof(Packet), 0, (struct sockaddr*)window->server_addr, &window->addr_len);
-        if (recv_len > 0 && ack.type == PKT_ACK) {
-            pthread_mutex_lock(&window->lock);
-            int seq = ack.seq_num;
-            int idx = seq % WINDOW_SIZE;
-
-            if(seq >= window->base && seq < window->next_seq_num) {
-                if(!window->acked[idx]){
-                    window->acked[idx] = 1;
-
-                    long long now = get_timestamp_ms();
-                    double sample_rtt = (now - window->send_times[idx]) / 1000.0;
+// Id de uma nova transferência: o servidor o repete em todas as respostas,
+// o que separa esta sessão de pacotes atrasados das anteriores
+uint32_t new_session_id()
+{
+    uint32_t id;
+    do {
+        id = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+    } while (id == 0);
+    return id;
+}
 
-                    window->dev_rtt = (1 -BETA) * window->dev_rtt + BETA * fabs(sample_rtt - window->estimated_rtt);
-                    window->estimated_rtt = (1 - ALPHA) * window->estimated_rtt + ALPHA * sample_rtt;
+// Requisição de upload e espera do ACK, que traz a porta da thread do servidor
+// e, na retomada, o ponto de onde continuar. Retorna -1 sem resposta
+int request_upload(int sockfd, const char *filename, int type, struct sockaddr_in *server_addr,
+                   socklen_t addr_len, uint32_t session_id, int resume, Packet *ack,
+                   struct sockaddr_in *thread_addr, socklen_t *thread_len, const char *tag)
+{
+    Packet req;
+    memset(&req, 0, sizeof(Packet));
+    req.type = type;
+    req.session_id = session_id;
+    req.seq_num = 0;
+    req.resume = resume;
+    strncpy(req.filename, filename, sizeof(req.filename) - 1);
+    
+    printf("%sEnviando requisição de upload...\n", tag);
+    send_packet(sockfd, &req, server_addr, addr_len);
+    
+    // Aguardar ACK da requisição
+    struct timeval tv;
+    tv.tv_sec = 5;
+    tv.tv_usec = 0;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    
+    // Receber ACK e descobrir porta da thread do servidor
+    // (pacotes de outras sessões, ex.: END repetido de um download, são ignorados)
+    *thread_len = sizeof(*thread_addr);
+    while (recv_packet(sockfd, ack, thread_addr, thread_len) > 0) {
+        if (ack->session_id != session_id) continue;
+        return ack->type == PKT_ACK ? 0 : -1;
+    }
+    return -1;
+}
 
-                    printf("  ACK recebido para seq=%d | RTT: %.3f s \n", seq, sample_rtt);
-                }
+// Envia os pacotes [resume_from, fim) do arquivo aberto em fd pela janela
+// deslizante à porta da thread do servidor e encerra com END, repetido a cada
+// RTO até o ACK. Com confirm o upload só vale com esse ACK (o servidor só
+// responde depois de aplicar o delta).
+// A janela começa das métricas do último upload para o mesmo servidor.
+// Retorna o total de pacotes, ou -1 sem memória ou com o END recusado
+int upload_window(int sockfd, int fd, uint32_t session_id, int resume_from,
+                  struct sockaddr_in *server_addr, socklen_t addr_len, int confirm,
+                  const char *tag)
+{
+    // Inicializar janela deslizante (no heap: o anel é dimensionado pela janela máxima)
+    SlidingWindow *window = (SlidingWindow*)calloc(1, sizeof(SlidingWindow));
+    if (!window || source_open(&window->source, fd, RING_SIZE) == -1) {
+        printf("%s❌ Erro ao alocar memória\n", tag);
+        free(window);
+        return -1;
+    }
+    
+    // Tamanho do arquivo define o total; os dados são lidos sob demanda
+    int total_packets = (int)((window->source.size + BUFLEN - 1) / BUFLEN);
+    sender_init(window, sockfd, server_addr, addr_len, session_id, resume_from, total_packets, cc_ops);
+    
+    // Sem mapeamento os blocos são lidos em sequência a partir da retomada
+    if (!window->source.map) lseek(fd, (off_t)resume_from * BUFLEN, SEEK_SET);
+    
+    printf("%s📦 Total de pacotes: %d\n", tag, total_packets);
+    printf("%s📊 Janela máxima: %d (%s)\n\n", tag, MAX_WINDOW, cc_ops->name);
+    
+    // Threads de ACKs e timeouts; este laço lê e envia até a janela drenar
+    sender_start(window);
+    sender_run(window);
+    total_packets = window->total_packets;
+    
+    log_flush();
+    
+    // Janela drenada (todos os pacotes confirmados): END vai para a porta da
+    // thread uma vez e é repetido a cada RTO, com backoff, até a resposta
+    printf("%sEnviando pacote END...\n", tag);
+    int end_status = sender_close(window);
+    if (end_status == 0) printf("%s⚠️  END sem resposta do servidor\n", tag);
+    
+    sender_stop(window);
+    fec_encoder_report(tag, window->fec);
+    sender_destroy(window);
+    
+    if (end_status == -1 || (confirm && end_status == 0)) return -1;
+    return total_packets;
+}
 
-                while (window->acked[window->base % WINDOW_SIZE] && window->base < window->total_packets) {
-                    window->acked[window->base % WINDOW_SIZE] = 0;
-                    window->base++;
-                    printf("  Janela movida. Nova base=%d\n", window->base);
-                }
-            }
-            pthread_mutex_unlock(&window->lock);
+//Upload
+// Envia o arquivo local path como name no servidor (retomando do checkpoint
+// do servidor quando o prefixo confere). Retorna o total de pacotes, ou -1;
+// em *bytes os bytes efetivamente enviados
+int upload_one(int sockfd, const char *path, const char *name, struct sockaddr_in *server_addr,
+               socklen_t addr_len, const char *tag, long long *bytes)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        printf("%s❌ Erro ao abrir arquivo: %s\n", tag, path);
+        return -1;
+    }
+    
+    // Enviar requisição inicial, pedindo retomada se o servidor tiver checkpoint
+    uint32_t session_id = new_session_id();
+    Packet ack;
+    struct sockaddr_in server_thread_addr;
+    socklen_t server_thread_len;
+    
+    int got_ack = request_upload(sockfd, name, PKT_UPLOAD_REQUEST, server_addr, addr_len,
+                                 session_id, 1, &ack, &server_thread_addr, &server_thread_len,
+                                 tag) == 0;
+    
+    // Retomada: o prefixo que o servidor já tem precisa ser igual ao arquivo local
+    int resume_from = 0;
+    if (got_ack && ack.cum_ack > 0) {
+        uint32_t hash;
+        if (resume_hash_file(fd, ack.cum_ack, &hash) == 0 && hash == ack.checksum) {
+            resume_from = ack.cum_ack;
+            printf("%s↻ Retomando do pacote %d (já recebidos pelo servidor)\n", tag, resume_from);
+        } else {
+            printf("%s↻ Checkpoint do servidor não confere com o arquivo local, recomeçando do zero\n", tag);
+            session_id = new_session_id();
+            got_ack = request_upload(sockfd, name, PKT_UPLOAD_REQUEST, server_addr, addr_len,
+                                     session_id, 0, &ack, &server_thread_addr, &server_thread_len,
+                                     tag) == 0;
         }
     }
-    return NULL;
-};
+    if (!got_ack) {
+        printf("%s❌ Servidor não respondeu à requisição\n", tag);
+        close(fd);
+        return -1;
+    }
+    
+    printf("%s✓ Servidor pronto para receber\n", tag);
+    printf("%s✓ Thread do servidor: %s:%d\n\n", tag,
+           inet_ntoa(server_thread_addr.sin_addr), 
+           ntohs(server_thread_addr.sin_port));
+    
+    // Daqui em diante a transferência fala com a porta da thread; o endereço
+    // do servidor (porta 9999) continua valendo para os próximos comandos
+    struct stat st;
+    fstat(fd, &st);
+    int total_packets = upload_window(sockfd, fd, session_id, resume_from,
+                                      &server_thread_addr, server_thread_len, 0, tag);
+    close(fd);
+    *bytes = (long long)st.st_size - (long long)resume_from * BUFLEN;
+    return total_packets;
+}
 
-void* thread_check_timeouts(void* arg)
+void upload_file(int sockfd, const char *filename, struct sockaddr_in *server_addr, socklen_t addr_len)
 {
-    SlidingWindow *window = (SlidingWindow*)arg;
+    printf("\n═══════════════════════════════════════════\n");
+    printf("UPLOAD: %s (Selective Repeat)\n", filename);
+    printf("═══════════════════════════════════════════\n");
+    
+    IoStats io_start = io_stats;
+    long long bytes = 0;
+    int total_packets = upload_one(sockfd, filename, filename, server_addr, addr_len, "", &bytes);
+    if (total_packets == -1) return;
+    
+    printf("\n✓ Upload concluído! (%d pacotes)\n", total_packets);
+    io_report("", &io_start, bytes);
+    printf("═══════════════════════════════════════════\n\n");
+}
+
+//Download
+// Resultado de uma sessão de download
+#define DOWNLOAD_OK 0
+#define DOWNLOAD_FAILED -1          // Timeout: o que chegou fica no arquivo
+#define DOWNLOAD_REFUSED -2         // Erro do servidor (ex.: arquivo inexistente)
+#define DOWNLOAD_MISMATCH -3        // Retomada recusada: o arquivo mudou no servidor
+
+// Recebe os pacotes [sink->base, end) de filename numa sessão própria e escreve
+// cada um no seu offset (end 0 = até o fim do arquivo). Com resume a requisição
+// leva o hash do prefixo já recebido, que o servidor confere antes de pulá-lo.
+// type é PKT_DOWNLOAD_REQUEST, ou PKT_SIGNATURE_REQUEST no upload por delta
+int download_range(int sockfd, const char *filename, int type, struct sockaddr_in *server_addr,
+                   socklen_t addr_len, FileSink *sink, int end, int resume)
+{
+    const char *tag = sink->tag;
+    uint32_t session_id = new_session_id();
+    Packet req;
+    memset(&req, 0, sizeof(Packet));
+    req.type = type;
+    req.session_id = session_id;
+    req.seq_num = 0;
+    req.range_first = sink->base;
+    req.range_end = end;
+    req.resume = resume;
+    req.resume_hash = sink->prefix_hash;
+    strncpy(req.filename, filename, sizeof(req.filename) - 1);
+    
+    printf("%sEnviando requisição de download...\n", tag);
+    send_packet(sockfd, &req, server_addr, addr_len);
+    
+    struct timeval tv;
+    tv.tv_sec = 10;
+    tv.tv_usec = 0;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    
+    struct sockaddr_in from_addr;
+    socklen_t from_len = sizeof(from_addr);
+    int first_packet = 1;
+    
+    PacketBatch *rx = (PacketBatch*)calloc(1, sizeof(PacketBatch));
+    if (rx && io_offload) batch_enable_gro(sockfd, rx);
+    FecDecoder *fec = NULL;
+    int result = DOWNLOAD_FAILED;
+    int done = 0;
     
-    while (!window->finished) {
-        usleep(100000); // Verifica a cada 100ms
+    while (rx && !done) {
+        int count = batch_recv(sockfd, rx);
         
-        pthread_mutex_lock(&window->lock);
+        if (count <= 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                printf("%s⏰ Timeout\n", tag);
+            }
+            break;
+        }
         
-        long long now = get_timestamp_ms();
-        int timeout_ms = (int)((window->estimated_rtt + 4 * window->dev_rtt) * 1000);
-        if (timeout_ms < 500) timeout_ms = 500;
-        if (timeout_ms > 5000) timeout_ms = 5000;
+        // Um ACK por lote: cum_ack + SACK cobrem todos os pacotes do lote e o
+        // seq do último pacote aceito serve de amostra de RTT ao servidor.
+        // A janela anunciada desconta o que ficou na fila do socket
+        int ack_seq = -1;
+        int room = socket_room(sockfd);
         
-        // Verifica cada pacote na janela
-        for (int seq = window->base; seq < window->next_seq_num; seq++) {
-            int idx = seq % WINDOW_SIZE;
+        for (int i = 0; i < count && !done; i++) {
+            Packet pkt;
+            if (batch_packet(rx, i, &pkt) == -1) continue;
+            
+            // Pacote atrasado de outra transferência
+            if (pkt.session_id != session_id) continue;
+            from_addr = rx->addrs[i];
+            from_len = rx->addr_lens[i];
+            
+            // Captura porta da thread no primeiro pacote DATA
+            if (first_packet && pkt.type == PKT_DATA) {
+                printf("%s✓ Thread do servidor: %s:%d\n", tag,
+                       inet_ntoa(from_addr.sin_addr), 
+                       ntohs(from_addr.sin_port));
+                first_packet = 0;
+            }
+            
+            if (pkt.type == PKT_ERROR) {
+                printf("%s❌ Erro: %s\n", tag, pkt.data);
+                result = strcmp(pkt.data, RESUME_MISMATCH_MSG) == 0 ? DOWNLOAD_MISMATCH
+                                                                    : DOWNLOAD_REFUSED;
+                done = 1;
+                break;
+            }
+            
+            if (pkt.type == PKT_END) {
+                if (ack_seq >= 0) {
+                    send_ack(sockfd, session_id, ack_seq, sink->base, sink_sack_bitmap(sink), 
+                             sink_rwnd(sink, room), fec_recovered(fec), &from_addr, from_len);
+                    ack_seq = -1;
+                }
+                send_ack(sockfd, session_id, pkt.seq_num, sink->base, 0, 0, fec_recovered(fec),
+                         &from_addr, from_len);
+                result = DOWNLOAD_OK;
+                done = 1;
+                break;
+            }
             
-            if (!window->acked[idx] && 
-                (now - window->send_times[idx]) > timeout_ms) {
-                
-                // RETRANSMITIR apenas este pacote (Selective Repeat)
-                Packet *pkt = &window->packets[idx];
-                sendto(window->sockfd, pkt, sizeof(Packet), 0, 
-                       (struct sockaddr*)window->server_addr, window->addr_len);
-                
-                window->send_times[idx] = now;
-                
-                printf("  🔄 Retransmitindo seq=%d (timeout=%dms)\n", seq, timeout_ms);
+            if (pkt.type == PKT_DATA && sink_on_data(sink, &pkt)) {
+                ack_seq = pkt.seq_num;
+            } else if (pkt.type == PKT_FEC && fec_on_parity(&fec, sink, &pkt) > 0) {
+                // Reconstruídos: o ACK leva o último pacote do bloco, recém-enviado
+                ack_seq = pkt.seq_num + pkt.fec_k - 1;
             }
         }
         
-        pthread_mutex_unlock(&window->lock);
+        // ACK cumulativo + SACK para porta da thread
+        if (ack_seq >= 0) {
+            send_ack(sockfd, session_id, ack_seq, sink->base, sink_sack_bitmap(sink), 
+                     sink_rwnd(sink, room), fec_recovered(fec), &from_addr, from_len);
+        }
     }
     
-    return NULL;
+    if (rx) batch_free(rx);
+    free(rx);
+    fec_decoder_finish(fec, tag);
+    log_flush();
+    return result;
 }
 
-void send_ack(int sockfd, int seq_num, struct sockaddr_in *addr, socklen_t addr_len)
+// Baixa filename para downloaded_<filename>, retomando de um checkpoint
+// local. Retorna DOWNLOAD_*; em *bytes os bytes recebidos
+int download_one(int sockfd, const char *filename, struct sockaddr_in *server_addr,
+                 socklen_t addr_len, const char *tag, long long *bytes)
 {
-    Packet ack;
-    memset(&ack, 0, sizeof(Packet));
-    ack.type = PKT_ACK;
-    ack.seq_num = seq_num;
+    char download_filename[300];
+    snprintf(download_filename, sizeof(download_filename), "downloaded_%s", filename);
     
-    sendto(sockfd, &ack, sizeof(Packet), 0, (struct sockaddr*)addr, addr_len);
-    printf("  ACK enviado para seq=%d\n", seq_num);
+    // Checkpoint de uma tentativa anterior: mantém o arquivo parcial e continua dali
+    Checkpoint ck;
+    int resume = checkpoint_load(download_filename, &ck) == 0;
+    // Leitura e escrita: a FEC relê os pacotes já gravados
+    int fd = resume ? open(download_filename, O_RDWR)
+                    : open(download_filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) {
+        printf("%s❌ Erro ao criar arquivo\n", tag);
+        return DOWNLOAD_FAILED;
+    }
+    
+    // Payload vai direto ao offset no arquivo; só o bitmap da janela em memória
+    FileSink sink;
+    sink_init(&sink, fd, 0, tag);
+    if (resume) {
+        sink_restore(&sink, &ck);
+        printf("%s↻ Retomando do pacote %d (checkpoint de tentativa anterior)\n", tag, sink.base);
+    }
+    sink_enable_checkpoint(&sink, download_filename);
+    
+    int result = download_range(sockfd, filename, PKT_DOWNLOAD_REQUEST, server_addr, addr_len,
+                                &sink, 0, resume);
+    if (result == DOWNLOAD_MISMATCH) {
+        // O arquivo mudou no servidor: o parcial não serve mais
+        printf("%s↻ Arquivo mudou no servidor, recomeçando do zero\n", tag);
+        if (ftruncate(fd, 0) == -1) perror("ftruncate");
+        sink_init(&sink, fd, 0, tag);
+        sink_enable_checkpoint(&sink, download_filename);
+        result = download_range(sockfd, filename, PKT_DOWNLOAD_REQUEST, server_addr, addr_len,
+                                &sink, 0, 0);
+    }
+    sink_finish(&sink, result == DOWNLOAD_OK);
+    
+    if (result == DOWNLOAD_REFUSED) {
+        unlink(download_filename);
+        checkpoint_remove(download_filename);
+    }
+    close(fd);
+    *bytes = sink.bytes;
+    return result;
 }
 
-//Upload
-void upload_file(int sockfd, const char *filename, struct sockaddr_in *server_addr, socklen_t addr_len)
+void download_file(int sockfd, const char *filename, struct sockaddr_in *server_addr, socklen_t addr_len)
 {
     printf("\n═══════════════════════════════════════════\n");
-    printf("UPLOAD: %s (Selective Repeat)\n", filename);
+    printf("DOWNLOAD: %s (Selective Repeat)\n", filename);
+    printf("═══════════════════════════════════════════\n");
+    
+    IoStats io_start = io_stats;
+    long long bytes = 0;
+    if (download_one(sockfd, filename, server_addr, addr_len, "", &bytes) == DOWNLOAD_OK) {
+        printf("\n✓ Download concluído\n");
+        io_report("", &io_start, bytes);
+    }
+    printf("═══════════════════════════════════════════\n\n");
+}
+
+// Upload por delta: baixa a assinatura da versão que o servidor já tem, monta o
+// delta localmente e envia só ele. Sem versão no servidor envia o arquivo inteiro
+void upload_delta(int sockfd, const char *filename, struct sockaddr_in *server_addr, socklen_t addr_len)
+{
+    printf("\n═══════════════════════════════════════════\n");
+    printf("UPLOAD POR DELTA: %s (Selective Repeat)\n", filename);
     printf("═══════════════════════════════════════════\n");
     
     int fd = open(filename, O_RDONLY);
@@ -192,279 +469,444 @@ void upload_file(int sockfd, const char *filename, struct sockaddr_in *server_ad
         return;
     }
     
-    // Enviar requisição inicial
-    Packet req;
-    memset(&req, 0, sizeof(Packet));
-    req.type = PKT_UPLOAD_REQUEST;
-    req.seq_num = 0;
-    strncpy(req.filename, filename, sizeof(req.filename) - 1);
-    
-    printf("Enviando requisição de upload...\n");
-    sendto(sockfd, &req, sizeof(Packet), 0, (struct sockaddr*)server_addr, addr_len);
+    IoStats io_start = io_stats;
+    long long start_ms = get_timestamp_ms();
     
-    // Aguardar ACK da requisição
-    struct timeval tv;
-    tv.tv_sec = 5;
-    tv.tv_usec = 0;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    
-    Packet ack;
-    struct sockaddr_in server_thread_addr;
-    socklen_t server_thread_len = sizeof(server_thread_addr);
-    
-    // Receber ACK e descobrir porta da thread do servidor
-    if (recvfrom(sockfd, &ack, sizeof(Packet), 0, 
-                (struct sockaddr*)&server_thread_addr, &server_thread_len) <= 0 || 
-        ack.type != PKT_ACK) {
-        printf("❌ Servidor não respondeu à requisição\n");
+    // 1. Assinatura de received_<nome>, recebida como um download num temporário
+    FILE *sig_file = tmpfile();
+    DeltaSignature sig;
+    int have_sig = 0;
+    if (sig_file) {
+        FileSink sink;
+        sink_init(&sink, fileno(sig_file), 0, "[ASSINATURA] ");
+        have_sig = download_range(sockfd, filename, PKT_SIGNATURE_REQUEST, server_addr, addr_len,
+                                  &sink, 0, 0) == DOWNLOAD_OK &&
+                   delta_signature_load(fileno(sig_file), &sig) == 0;
+        fclose(sig_file);
+    }
+    if (!have_sig) {
+        printf("↪ Servidor sem versão anterior utilizável, enviando o arquivo inteiro\n");
         close(fd);
+        upload_file(sockfd, filename, server_addr, addr_len);
         return;
     }
+    printf("✓ Assinatura: %d blocos de %d bytes\n", sig.blocks, DELTA_BLOCK);
     
-    printf("✓ Servidor pronto para receber\n");
-    printf("✓ Thread do servidor: %s:%d\n\n", 
-           inet_ntoa(server_thread_addr.sin_addr), 
-           ntohs(server_thread_addr.sin_port));
-    
-    // Atualizar endereço do servidor para a porta da thread
-    *server_addr = server_thread_addr;
-    
-    // Inicializar janela deslizante
-    SlidingWindow window;
-    memset(&window, 0, sizeof(SlidingWindow));
-    window.base = 0;
-    window.next_seq_num = 0;
-    window.sockfd = sockfd;
-    window.server_addr = server_addr;
-    window.addr_len = addr_len;
-    window.finished = 0;
-    window.estimated_rtt = 1.0;
-    window.dev_rtt = 0.5;
-    pthread_mutex_init(&window.lock, NULL);
-    
-    // Ler arquivo e preparar pacotes (buffer dinâmico)
-    Packet *all_packets = (Packet*)malloc(1000 * sizeof(Packet));
-    if (!all_packets) {
-        printf("❌ Erro ao alocar memória\n");
+    // 2. Delta do arquivo local (mapeado) contra a assinatura, num temporário
+    FileSource src;
+    FILE *delta_file = tmpfile();
+    uint32_t new_hash = 0;
+    int packets = 0;
+    int ready = delta_file && source_open(&src, fd, 1) == 0;
+    if (ready) {
+        packets = (int)((src.size + BUFLEN - 1) / BUFLEN);
+        ready = (src.map || src.size == 0) && resume_hash_file(fd, packets, &new_hash) == 0;
+    }
+    if (!ready) {
+        printf("❌ Erro ao montar o delta\n");
+        if (delta_file) fclose(delta_file);
+        delta_signature_free(&sig);
         close(fd);
         return;
     }
     
-    int total_packets = 0;
-    int bytes_read;
+    DeltaStats stats;
+    delta_build(&sig, src.map, src.size, new_hash, delta_file, &stats);
+    fflush(delta_file);
+    delta_signature_free(&sig);
+    long long file_size = src.size;
+    source_close(&src);
+    
+    int delta_fd = fileno(delta_file);
+    struct stat st;
+    fstat(delta_fd, &st);
+    printf("🧮 Delta: %lld bytes literais + %lld bytes em %d referências → %lld bytes a enviar\n",
+           stats.literal_bytes, stats.copied_bytes, stats.copy_ops, (long long)st.st_size);
     
-    while ((bytes_read = read(fd, all_packets[total_packets].data, BUFLEN)) > 0) {
-        all_packets[total_packets].type = PKT_DATA;
-        all_packets[total_packets].seq_num = total_packets;
-        all_packets[total_packets].data_len = bytes_read;
-        all_packets[total_packets].checksum = 
-            calculate_checksum(all_packets[total_packets].data, bytes_read);
-        total_packets++;
-        if (total_packets >= 1000) break;
+    // 3. Delta enviado como um upload; o ACK do END confirma a remontagem
+    uint32_t session_id = new_session_id();
+    Packet ack;
+    struct sockaddr_in server_thread_addr;
+    socklen_t server_thread_len;
+    int total_packets = -1;
+    if (request_upload(sockfd, filename, PKT_DELTA_REQUEST, server_addr, addr_len, session_id, 0,
+                       &ack, &server_thread_addr, &server_thread_len, "") == 0) {
+        total_packets = upload_window(sockfd, delta_fd, session_id, 0,
+                                      &server_thread_addr, server_thread_len, 1, "");
+    } else {
+        printf("❌ Servidor não respondeu à requisição\n");
     }
+    fclose(delta_file);
     close(fd);
     
-    window.total_packets = total_packets;
-    printf("📦 Total de pacotes: %d\n", total_packets);
-    printf("📊 Tamanho da janela: %d\n\n", WINDOW_SIZE);
+    if (total_packets == -1) {
+        printf("❌ Delta não confirmado pelo servidor (versão anterior mantida)\n");
+    } else {
+        double seconds = (get_timestamp_ms() - start_ms) / 1000.0;
+        printf("\n✓ Upload por delta concluído! %lld de %lld bytes enviados (%.1f%%) em %.2f s\n",
+               (long long)st.st_size, file_size,
+               file_size > 0 ? 100.0 * st.st_size / file_size : 0.0, seconds);
+        io_report("", &io_start, file_size);
+    }
+    printf("═══════════════════════════════════════════\n\n");
+}
+
+// Consulta o tamanho de filename (STAT_REQUEST); retorna -1 se o servidor
+// não responder ou o arquivo não existir
+int query_size(int sockfd, const char *filename, struct sockaddr_in *server_addr,
+               socklen_t addr_len, int *total_packets, long long *size)
+{
+    uint32_t session_id = new_session_id();
+    Packet req;
+    memset(&req, 0, sizeof(Packet));
+    req.type = PKT_STAT_REQUEST;
+    req.session_id = session_id;
+    strncpy(req.filename, filename, sizeof(req.filename) - 1);
     
-    // Criar threads
-    pthread_t tid_ack, tid_timeout;
-    pthread_create(&tid_ack, NULL, thread_receive_acks, &window);
-    pthread_create(&tid_timeout, NULL, thread_check_timeouts, &window);
+    struct timeval tv;
+    tv.tv_sec = 1;
+    tv.tv_usec = 0;
+    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
     
-    // LOOP PRINCIPAL: Envia pacotes conforme janela permite
-    while (window.base < total_packets) {
-        pthread_mutex_lock(&window.lock);
+    for (int attempt = 1; attempt <= MAX_RETRIES; attempt++) {
+        send_packet(sockfd, &req, server_addr, addr_len);
         
-        // Envia novos pacotes se houver espaço na janela
-        while (window.next_seq_num < window.base + WINDOW_SIZE && 
-               window.next_seq_num < total_packets) {
+        Packet resp;
+        struct sockaddr_in from_addr;
+        socklen_t from_len = sizeof(from_addr);
+        while (recv_packet(sockfd, &resp, &from_addr, &from_len) > 0) {
+            // Pacote atrasado de outra transferência
+            if (resp.session_id != session_id) continue;
             
-            int idx = window.next_seq_num % WINDOW_SIZE;
-            window.packets[idx] = all_packets[window.next_seq_num];
-            window.acked[idx] = 0;
-            window.send_times[idx] = get_timestamp_ms();
-            
-            // Envia para a porta da thread (não para porta 9999)
-            sendto(sockfd, &window.packets[idx], sizeof(Packet), 0, 
-                   (struct sockaddr*)server_addr, addr_len);
-            
-            printf("📤 Enviado seq=%d [base=%d, janela=%d-%d]\n", 
-                   window.next_seq_num, window.base, 
-                   window.base, window.base + WINDOW_SIZE - 1);
-            
-            window.next_seq_num++;
+            if (resp.type == PKT_ERROR) {
+                printf("❌ Erro: %s\n", resp.data);
+                return -1;
+            }
+            if (resp.type == PKT_ACK) {
+                *total_packets = resp.cum_ack;
+                *size = (long long)resp.sack_bits;
+                return 0;
+            }
         }
-        
-        pthread_mutex_unlock(&window.lock);
-        usleep(10000); // 10ms
+        printf("⏰ Timeout na consulta do tamanho (tentativa %d/%d)\n", attempt, MAX_RETRIES);
     }
+    return -1;
+}
+
+#define MAX_STREAMS 16
+
+// Um fluxo do download em paralelo: faixa [first, end) em socket próprio
+typedef struct {
+    const char *filename;
+    struct sockaddr_in server_addr;
+    socklen_t addr_len;
+    int fd;
+    int first;
+    int end;
+    char tag[16];
+    int result;
+    long long bytes;
+} StreamArgs;
+
+void* thread_stream(void *arg)
+{
+    StreamArgs *stream = (StreamArgs*)arg;
     
-    printf("\n⏳ Aguardando ACKs finais...\n");
-    sleep(2); // Aguarda ACKs finais
-    
-    // Envia pacote END
-    Packet end_pkt;
-    memset(&end_pkt, 0, sizeof(Packet));
-    end_pkt.type = PKT_END;
-    end_pkt.seq_num = total_packets;
-    
-    printf("Enviando pacote END...\n");
-    for (int i = 0; i < 3; i++) {
-        // END também vai para porta da thread
-        sendto(sockfd, &end_pkt, sizeof(Packet), 0, 
-               (struct sockaddr*)server_addr, addr_len);
-        usleep(100000);
+    // Socket próprio: o servidor vê cada fluxo como uma sessão independente,
+    // com janela e controle de congestionamento separados
+    int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sockfd == -1) {
+        perror("socket");
+        stream->result = DOWNLOAD_FAILED;
+        return NULL;
     }
     
-    // Encerra threads
-    window.finished = 1;
-    pthread_join(tid_ack, NULL);
-    pthread_join(tid_timeout, NULL);
-    pthread_mutex_destroy(&window.lock);
-    
-    printf("\n✓ Upload concluído! (%d pacotes)\n", total_packets);
-    printf("═══════════════════════════════════════════\n\n");
-    
-    free(all_packets);
+    FileSink sink;
+    sink_init(&sink, stream->fd, stream->first, stream->tag);
+    stream->result = download_range(sockfd, stream->filename, PKT_DOWNLOAD_REQUEST,
+                                    &stream->server_addr, stream->addr_len, &sink, stream->end, 0);
+    stream->bytes = sink.bytes;
+    close(sockfd);
+    return NULL;
 }
 
-//Download
-void download_file(int sockfd, const char *filename, struct sockaddr_in *server_addr, socklen_t addr_len)
+// Download em N fluxos: o arquivo é dividido em faixas contíguas de pacotes,
+// cada uma baixada por uma sessão própria e escrita com pwrite no mesmo arquivo
+void download_striped(int sockfd, const char *filename, struct sockaddr_in *server_addr,
+                      socklen_t addr_len, int streams)
 {
     printf("\n═══════════════════════════════════════════\n");
-    printf("DOWNLOAD: %s (Selective Repeat)\n", filename);
+    printf("DOWNLOAD: %s (%d fluxos em paralelo)\n", filename, streams);
     printf("═══════════════════════════════════════════\n");
     
-    Packet req;
-    memset(&req, 0, sizeof(Packet));
-    req.type = PKT_DOWNLOAD_REQUEST;
-    req.seq_num = 0;
-    strncpy(req.filename, filename, sizeof(req.filename) - 1);
-    
-    printf("Enviando requisição de download...\n");
-    sendto(sockfd, &req, sizeof(Packet), 0, (struct sockaddr*)server_addr, addr_len);
+    IoStats io_start = io_stats;
+    int total_packets;
+    long long size;
+    if (query_size(sockfd, filename, server_addr, addr_len, &total_packets, &size) == -1) {
+        printf("═══════════════════════════════════════════\n\n");
+        return;
+    }
+    if (streams > total_packets) streams = total_packets > 0 ? total_packets : 1;
+    printf("📦 %lld bytes, %d pacotes em %d faixas\n", size, total_packets, streams);
     
     char download_filename[300];
     snprintf(download_filename, sizeof(download_filename), "downloaded_%s", filename);
     
-    int fd = creat(download_filename, 0666);
+    int fd = open(download_filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
     if (fd == -1) {
         printf("❌ Erro ao criar arquivo\n");
         return;
     }
+    // Tamanho final reservado de uma vez: as faixas terminam em qualquer ordem
+    if (ftruncate(fd, size) == -1) perror("ftruncate");
     
-    // Buffer dinâmico para recebimento fora de ordem
-    Packet *buffer = (Packet*)malloc(1000 * sizeof(Packet));
-    int *received = (int*)calloc(1000, sizeof(int));
-    if (!buffer || !received) {
-        printf("❌ Erro ao alocar memória\n");
-        close(fd);
-        if (buffer) free(buffer);
-        if (received) free(received);
-        return;
+    long long start_ms = get_timestamp_ms();
+    StreamArgs args[MAX_STREAMS];
+    pthread_t tids[MAX_STREAMS];
+    for (int i = 0; i < streams; i++) {
+        args[i].filename = filename;
+        args[i].server_addr = *server_addr;
+        args[i].addr_len = addr_len;
+        args[i].fd = fd;
+        args[i].first = (int)((long long)total_packets * i / streams);
+        args[i].end = (int)((long long)total_packets * (i + 1) / streams);
+        args[i].result = DOWNLOAD_FAILED;
+        args[i].bytes = 0;
+        snprintf(args[i].tag, sizeof(args[i].tag), "[F%d] ", i + 1);
+        printf("%s✂️  Faixa: pacotes %d a %d\n", args[i].tag, args[i].first, args[i].end - 1);
+        pthread_create(&tids[i], NULL, thread_stream, &args[i]);
     }
-    int base = 0;
     
-    struct timeval tv;
-    tv.tv_sec = 10;
-    tv.tv_usec = 0;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int completed = 0;
+    long long bytes = 0;
+    for (int i = 0; i < streams; i++) {
+        pthread_join(tids[i], NULL);
+        if (args[i].result == DOWNLOAD_OK) completed++;
+        bytes += args[i].bytes;
+    }
+    double seconds = (get_timestamp_ms() - start_ms) / 1000.0;
     
-    struct sockaddr_in from_addr;
-    socklen_t from_len = sizeof(from_addr);
-    int first_packet = 1;
+    if (completed == streams) {
+        printf("\n✓ Download concluído (%d faixas)\n", streams);
+        printf("⚡ %.2f MB/s agregados em %.2f s\n",
+               seconds > 0 ? bytes / (1024.0 * 1024.0) / seconds : 0.0, seconds);
+        io_report("", &io_start, bytes);
+    } else {
+        // Arquivo já tem o tamanho final: faixas faltando seriam buracos com zeros
+        printf("\n❌ Download incompleto: %d de %d faixas\n", completed, streams);
+        unlink(download_filename);
+    }
     
-    while (1) {
-        Packet pkt;
-        memset(&pkt, 0, sizeof(Packet));
-        
-        int recv_len = recvfrom(sockfd, &pkt, sizeof(Packet), 0, 
-                                (struct sockaddr*)&from_addr, &from_len);
-        
-        if (recv_len <= 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                printf("⏰ Timeout\n");
+    close(fd);
+    printf("═══════════════════════════════════════════\n\n");
+}
+
+// ═══ Lotes (mput/mget) ═══
+// Cada arquivo continua sendo uma sessão no servidor (o id identifica a
+// transferência), mas o lote é atendido por N faixas (--pipeline N), cada uma
+// com um socket próprio reaproveitado de arquivo em arquivo: enquanto uma
+// faixa espera os ACKs finais e o END de um arquivo, as outras já enviam a
+// primeira janela dos próximos. RTT, cwnd e ssthresh passam de um arquivo
+// para o outro (path_cache.h), no cliente nos uploads e no servidor nos downloads.
+
+#define BATCH_PIPELINE 4            // Transferências em andamento ao mesmo tempo (padrão)
+#define MAX_PIPELINE 16
+#define BATCH_ATTEMPTS 2            // Tentativas por arquivo (a segunda retoma do checkpoint)
+
+typedef struct {
+    char **names;                   // Caminhos locais (mput) ou nomes no servidor (mget)
+    int count;
+    int upload;
+    struct sockaddr_in server_addr;
+    socklen_t addr_len;
+    pthread_mutex_t lock;           // Protege os campos abaixo
+    int next;                       // Próximo arquivo a iniciar
+    int completed;
+    long long bytes;
+} BatchQueue;
+
+// Acrescenta name à lista do lote
+static void batch_append(char ***names, int *count, const char *name)
+{
+    char **grown = (char**)realloc(*names, (*count + 1) * sizeof(char*));
+    if (!grown || !(grown[*count] = strdup(name))) die("malloc");
+    *names = grown;
+    (*count)++;
+}
+
+// Monta a lista do lote a partir da linha digitada: nomes separados por
+// espaço, @arquivo com um nome por linha e, no mput, padrões glob expandidos
+// localmente (só arquivos regulares). Retorna o número de arquivos
+int batch_collect(char *line, int upload, char ***names)
+{
+    int count = 0;
+    *names = NULL;
+    
+    for (char *tok = strtok(line, " \t"); tok; tok = strtok(NULL, " \t")) {
+        if (tok[0] == '@') {
+            FILE *list = fopen(tok + 1, "r");
+            if (!list) {
+                printf("⚠️  Lista não encontrada: %s\n", tok + 1);
+                continue;
             }
-            break;
-        }
-        
-        // Captura porta da thread no primeiro pacote DATA
-        if (first_packet && pkt.type == PKT_DATA) {
-            printf("✓ Thread do servidor: %s:%d\n", 
-                   inet_ntoa(from_addr.sin_addr), 
-                   ntohs(from_addr.sin_port));
-            first_packet = 0;
-        }
-        
-        if (pkt.type == PKT_ERROR) {
-            printf("❌ Erro: %s\n", pkt.data);
-            close(fd);
-            unlink(download_filename);
-            free(buffer);
-            free(received);
-            return;
-        }
-        
-        if (pkt.type == PKT_END) {
-            Packet ack;
-            memset(&ack, 0, sizeof(Packet));
-            ack.type = PKT_ACK;
-            ack.seq_num = pkt.seq_num;
-            // ACK vai para porta da thread
-            sendto(sockfd, &ack, sizeof(Packet), 0, 
-                   (struct sockaddr*)&from_addr, from_len);
-            printf("\n✓ Download concluído\n");
-            break;
-        }
-        
-        if (pkt.type == PKT_DATA) {
-            // Verificar checksum
-            unsigned int calc_checksum = calculate_checksum(pkt.data, pkt.data_len);
-            if (pkt.checksum != calc_checksum) {
-                printf("❌ Checksum inválido seq=%d\n", pkt.seq_num);
+            char entry[256];
+            while (fgets(entry, sizeof(entry), list)) {
+                entry[strcspn(entry, "\r\n")] = 0;
+                if (entry[0]) batch_append(names, &count, entry);
+            }
+            fclose(list);
+        } else if (upload) {
+            glob_t g;
+            if (glob(tok, 0, NULL, &g) != 0) {
+                printf("⚠️  Nenhum arquivo para: %s\n", tok);
                 continue;
             }
-            
-            // Armazenar pacote
-            if (!received[pkt.seq_num]) {
-                buffer[pkt.seq_num] = pkt;
-                received[pkt.seq_num] = 1;
-                printf("📥 Recebido seq=%d ✓ Checksum OK\n", pkt.seq_num);
+            for (size_t i = 0; i < g.gl_pathc; i++) {
+                struct stat st;
+                if (stat(g.gl_pathv[i], &st) == 0 && S_ISREG(st.st_mode)) {
+                    batch_append(names, &count, g.gl_pathv[i]);
+                }
             }
-            
-            // Envia ACK seletivo para porta da thread
-            Packet ack;
-            memset(&ack, 0, sizeof(Packet));
-            ack.type = PKT_ACK;
-            ack.seq_num = pkt.seq_num;
-            sendto(sockfd, &ack, sizeof(Packet), 0, 
-                   (struct sockaddr*)&from_addr, from_len);
-            
-            // Escrever pacotes em ordem no arquivo
-            while (received[base]) {
-                write(fd, buffer[base].data, buffer[base].data_len);
-                printf("💾 Escrito seq=%d no arquivo\n", base);
-                base++;
+            globfree(&g);
+        } else {
+            batch_append(names, &count, tok);
+        }
+    }
+    return count;
+}
+
+// Uma faixa do lote: pega o próximo arquivo da fila até ela esvaziar
+void* thread_batch(void *arg)
+{
+    BatchQueue *queue = (BatchQueue*)arg;
+    
+    int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sockfd == -1) {
+        perror("socket");
+        return NULL;
+    }
+    pacing_limit_socket(sockfd);
+    
+    while (1) {
+        pthread_mutex_lock(&queue->lock);
+        int i = queue->next++;
+        pthread_mutex_unlock(&queue->lock);
+        if (i >= queue->count) break;
+        
+        const char *name = queue->names[i];
+        char tag[32];
+        snprintf(tag, sizeof(tag), "[%d/%d] ", i + 1, queue->count);
+        
+        // Uma requisição perdida não derruba o arquivo: tenta de novo
+        long long bytes = 0;
+        int ok = 0;
+        for (int attempt = 0; attempt < BATCH_ATTEMPTS && !ok; attempt++) {
+            long long sent = 0;
+            if (queue->upload) {
+                // No servidor só o nome do arquivo: received_<nome> fica no diretório dele
+                const char *slash = strrchr(name, '/');
+                ok = upload_one(sockfd, name, slash ? slash + 1 : name, &queue->server_addr,
+                                queue->addr_len, tag, &sent) != -1;
+            } else {
+                int result = download_one(sockfd, name, &queue->server_addr, queue->addr_len,
+                                          tag, &sent);
+                ok = result == DOWNLOAD_OK;
+                if (result == DOWNLOAD_REFUSED) attempt = BATCH_ATTEMPTS;
             }
+            bytes += sent;
         }
+        printf("%s%s %s\n", tag, ok ? "✓" : "❌", name);
+        
+        pthread_mutex_lock(&queue->lock);
+        if (ok) queue->completed++;
+        queue->bytes += bytes;
+        pthread_mutex_unlock(&queue->lock);
     }
+    close(sockfd);
+    return NULL;
+}
+
+// mput/mget: transfere a lista em pipeline de até pipeline arquivos
+void transfer_batch(int upload, char **names, int count, struct sockaddr_in *server_addr,
+                    socklen_t addr_len, int pipeline)
+{
+    printf("\n═══════════════════════════════════════════\n");
+    printf("%s: %d arquivos (pipeline de %d)\n", upload ? "MPUT" : "MGET", count, pipeline);
+    printf("═══════════════════════════════════════════\n");
     
-    close(fd);
-    free(buffer);
-    free(received);
+    BatchQueue queue;
+    memset(&queue, 0, sizeof(queue));
+    queue.names = names;
+    queue.count = count;
+    queue.upload = upload;
+    queue.server_addr = *server_addr;
+    queue.addr_len = addr_len;
+    pthread_mutex_init(&queue.lock, NULL);
+    
+    IoStats io_start = io_stats;
+    long long start_ms = get_timestamp_ms();
+    if (pipeline > count) pipeline = count;
+    pthread_t tids[MAX_PIPELINE];
+    int lanes = 0;
+    for (int i = 0; i < pipeline; i++) {
+        if (pthread_create(&tids[lanes], NULL, thread_batch, &queue) == 0) lanes++;
+    }
+    for (int i = 0; i < lanes; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+    double seconds = (get_timestamp_ms() - start_ms) / 1000.0;
+    
+    log_flush();
+    printf("\n%s Lote: %d de %d arquivos em %.2f s (%.1f arquivos/s, %.2f MB/s)\n",
+           queue.completed == count ? "✓" : "❌", queue.completed, count, seconds,
+           seconds > 0 ? queue.completed / seconds : 0.0,
+           seconds > 0 ? queue.bytes / (1024.0 * 1024.0) / seconds : 0.0);
+    io_report("", &io_start, queue.bytes);
     printf("═══════════════════════════════════════════\n\n");
 }
 
-int main(void)
+int main(int argc, char *argv[])
 {
     struct sockaddr_in si_other;
     int s;
     socklen_t slen = sizeof(si_other);
     char server_ip[16];
-    char command[10];
+    char command[64];
     char filename[256];
+    char names_line[4096];
+    
+    // Opções: --cc reno|cubic|delay, --gso, --rate <Mbit/s>, --fec, --verbose
+    int verbose = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cc") == 0 && i + 1 < argc) {
+            cc_ops = cc_find(argv[++i]);
+            if (!cc_ops) {
+                fprintf(stderr, "Algoritmo desconhecido: %s (use reno, cubic ou delay)\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--gso") == 0) {
+            io_offload = 1;
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            pacing_max_rate = atof(argv[++i]) * 1e6 / 8;
+            if (pacing_max_rate <= 0) {
+                fprintf(stderr, "Taxa inválida: %s (Mbit/s)\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--fec") == 0) {
+            fec_enabled = 1;
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = 1;
+        } else {
+            fprintf(stderr, "Uso: %s [--cc reno|cubic|delay] [--gso] [--rate <Mbit/s>] [--fec] [--verbose]\n", argv[0]);
+            exit(1);
+        }
+    }
+    
+    // Modo de vazão: log por pacote só com --verbose
+    log_start(verbose ? LOG_PACKET : LOG_INFO);
+    
+    srand((unsigned)time(NULL) ^ ((unsigned)getpid() << 16));
     
     printf("═══════════════════════════════════════════\n");
     printf("   CLIENTE FTP UDP - SLIDING WINDOW\n");
@@ -473,6 +915,7 @@ int main(void)
     if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
         die("socket");
     }
+    pacing_limit_socket(s);
     
     printf("Digite o IP do servidor: ");
     fgets(server_ip, sizeof(server_ip), stdin);
@@ -491,15 +934,54 @@ int main(void)
     
     printf("Comandos disponíveis:\n");
     printf("  upload <arquivo>   - Enviar arquivo\n");
+    printf("  upload --delta     - Enviar só o que mudou em relação à versão do servidor\n");
     printf("  download <arquivo> - Baixar arquivo\n");
+    printf("  download --streams N - Baixar em N fluxos paralelos (até %d)\n", MAX_STREAMS);
+    printf("  mput <arquivos>    - Enviar vários (nomes, padrões glob ou @lista)\n");
+    printf("  mget <arquivos>    - Baixar vários (nomes ou @lista)\n");
+    printf("  mput/mget --pipeline N - Até N arquivos em andamento (padrão %d, até %d)\n",
+           BATCH_PIPELINE, MAX_PIPELINE);
     printf("  sair               - Encerrar cliente\n\n");
     
     while (1) {
+        log_flush();
         printf("> ");
         //espera o comando
         fgets(command, sizeof(command), stdin);
         command[strcspn(command, "\n")] = 0;
         
+        // Opção do download: "download --streams N"
+        int streams = 1;
+        char *opt = strstr(command, " --streams");
+        if (opt) {
+            streams = atoi(opt + strlen(" --streams"));
+            *opt = 0;
+            if (streams < 1 || streams > MAX_STREAMS) {
+                printf("Número de fluxos inválido (1 a %d)\n", MAX_STREAMS);
+                continue;
+            }
+        }
+        
+        // Opção dos lotes: "mput --pipeline N"
+        int pipeline = BATCH_PIPELINE;
+        opt = strstr(command, " --pipeline");
+        if (opt) {
+            pipeline = atoi(opt + strlen(" --pipeline"));
+            *opt = 0;
+            if (pipeline < 1 || pipeline > MAX_PIPELINE) {
+                printf("Pipeline inválido (1 a %d)\n", MAX_PIPELINE);
+                continue;
+            }
+        }
+        
+        // Opção do upload: "upload --delta"
+        int delta = 0;
+        opt = strstr(command, " --delta");
+        if (opt) {
+            delta = 1;
+            *opt = 0;
+        }
+        
         if (strcmp(command, "sair") == 0 || strcmp(command, "SAIR") == 0) {
             break;
         }
@@ -508,17 +990,42 @@ int main(void)
             fgets(filename, sizeof(filename), stdin);
             filename[strcspn(filename, "\n")] = 0;
             
-            upload_file(s, filename, &si_other, slen);
+            if (delta) {
+                upload_delta(s, filename, &si_other, slen);
+            } else {
+                upload_file(s, filename, &si_other, slen);
+            }
         }
         else if (strcmp(command, "download") == 0 || strcmp(command, "DOWNLOAD") == 0) {
             printf("Nome do arquivo: ");
             fgets(filename, sizeof(filename), stdin);
             filename[strcspn(filename, "\n")] = 0;
             
-            download_file(s, filename, &si_other, slen);
+            if (streams > 1) {
+                download_striped(s, filename, &si_other, slen, streams);
+            } else {
+                download_file(s, filename, &si_other, slen);
+            }
+        }
+        else if (strcmp(command, "mput") == 0 || strcmp(command, "MPUT") == 0 ||
+                 strcmp(command, "mget") == 0 || strcmp(command, "MGET") == 0) {
+            int upload = command[1] == 'p' || command[1] == 'P';
+            printf("Arquivos: ");
+            fgets(names_line, sizeof(names_line), stdin);
+            names_line[strcspn(names_line, "\n")] = 0;
+            
+            char **names;
+            int count = batch_collect(names_line, upload, &names);
+            if (count > 0) {
+                transfer_batch(upload, names, count, &si_other, slen, pipeline);
+            } else {
+                printf("Nenhum arquivo no lote\n");
+            }
+            for (int i = 0; i < count; i++) free(names[i]);
+            free(names);
         }
         else {
-            printf("Comando não reconhecido. Use: upload, download ou sair\n");
+            printf("Comando não reconhecido. Use: upload, download, mput, mget ou sair\n");
         }
     }
     
@@ -0,0 +1,187 @@
+/*
+    Controle de congestionamento para a janela deslizante
+    Compartilhado por client.cpp e server.cpp
+
+    A janela de envio deixa de ser fixa: cada sessão tem um CongestionControl
+    que recebe os sinais já coletados pela thread de ACKs (ACK + amostra de RTT)
+    e pela thread de timeouts (perda) e ajusta cwnd em pacotes.
+
+    Algoritmos (escolhidos com --cc <nome>):
+      - reno:  AIMD clássico (slow start, +1 por RTT, metade na perda)
+      - cubic: crescimento cúbico em função do tempo desde a última perda
+      - delay: baseado em atraso (estilo Vegas), mantém poucos pacotes na fila
+*/
+#ifndef FTP_CONGESTION_H
+#define FTP_CONGESTION_H
+
+#include <math.h>
+#include <string.h>
+
+#define MAX_WINDOW 256         // Limite da janela (dimensiona os anéis de envio e recepção)
+#define INITIAL_CWND 4.0
+
+#define CUBIC_C 0.4
+#define CUBIC_BETA 0.7
+#define DELAY_ALPHA 2.0        // pacotes na fila abaixo dos quais a janela cresce
+#define DELAY_BETA 4.0         // pacotes na fila acima dos quais a janela diminui
+
+typedef struct CongestionControl CongestionControl;
+
+typedef struct {
+    const char *name;
+    void (*on_ack)(CongestionControl *cc, double rtt, double now);
+    void (*on_loss)(CongestionControl *cc, int timeout, double now);
+} CongestionOps;
+
+struct CongestionControl {
+    const CongestionOps *ops;
+    double cwnd;               // janela em pacotes
+    double ssthresh;
+    int max_window;
+    int recovery_seq;          // perdas abaixo deste seq pertencem ao mesmo evento
+
+    // CUBIC
+    double w_max;
+    double epoch_start;
+    double k;
+    double reno_cwnd;          // estimativa "TCP-friendly"
+
+    // Baseado em atraso
+    double base_rtt;
+};
+
+// Reno
+static void reno_on_ack(CongestionControl *cc, double rtt, double now)
+{
+    (void)rtt; (void)now;
+    if (cc->cwnd < cc->ssthresh)
+        cc->cwnd += 1.0;               // slow start: dobra por RTT
+    else
+        cc->cwnd += 1.0 / cc->cwnd;    // congestion avoidance: +1 por RTT
+}
+
+static void reno_on_loss(CongestionControl *cc, int timeout, double now)
+{
+    (void)now;
+    cc->ssthresh = fmax(cc->cwnd / 2.0, 2.0);
+    cc->cwnd = timeout ? 1.0 : cc->ssthresh;
+}
+
+// CUBIC
+static void cubic_on_ack(CongestionControl *cc, double rtt, double now)
+{
+    if (cc->cwnd < cc->ssthresh) {
+        cc->cwnd += 1.0;
+        return;
+    }
+    if (cc->epoch_start <= 0) {
+        // Início de uma época: W(t) = C(t - K)^3 + W_max
+        cc->epoch_start = now;
+        if (cc->w_max < cc->cwnd) cc->w_max = cc->cwnd;
+        cc->k = cbrt(cc->w_max * (1.0 - CUBIC_BETA) / CUBIC_C);
+        cc->reno_cwnd = cc->cwnd;
+    }
+    double t = now - cc->epoch_start + rtt;
+    double target = CUBIC_C * pow(t - cc->k, 3) + cc->w_max;
+
+    // Região TCP-friendly: nunca cresce mais devagar que o Reno equivalente
+    cc->reno_cwnd += 3.0 * (1.0 - CUBIC_BETA) / (1.0 + CUBIC_BETA) / cc->cwnd;
+    if (target < cc->reno_cwnd) target = cc->reno_cwnd;
+
+    if (target > cc->cwnd)
+        cc->cwnd += (target - cc->cwnd) / cc->cwnd;
+}
+
+static void cubic_on_loss(CongestionControl *cc, int timeout, double now)
+{
+    (void)now;
+    // Convergência rápida: libera banda se a perda veio antes do W_max anterior
+    if (cc->cwnd < cc->w_max)
+        cc->w_max = cc->cwnd * (1.0 + CUBIC_BETA) / 2.0;
+    else
+        cc->w_max = cc->cwnd;
+    cc->epoch_start = 0;
+    cc->ssthresh = fmax(cc->cwnd * CUBIC_BETA, 2.0);
+    cc->cwnd = timeout ? 1.0 : cc->ssthresh;
+}
+
+// Baseado em atraso: compara a vazão esperada (cwnd/base_rtt) com a real (cwnd/rtt)
+static void delay_on_ack(CongestionControl *cc, double rtt, double now)
+{
+    (void)now;
+    if (rtt > 0 && (cc->base_rtt <= 0 || rtt < cc->base_rtt))
+        cc->base_rtt = rtt;
+
+    // Pacotes parados em filas ao longo do caminho
+    double queued = (rtt > 0 && cc->base_rtt > 0) ? cc->cwnd * (1.0 - cc->base_rtt / rtt) : 0;
+
+    if (cc->cwnd < cc->ssthresh && queued < 1.0) {
+        cc->cwnd += 1.0;
+    } else {
+        if (cc->cwnd < cc->ssthresh) cc->ssthresh = cc->cwnd;
+        if (queued < DELAY_ALPHA)
+            cc->cwnd += 1.0 / cc->cwnd;
+        else if (queued > DELAY_BETA)
+            cc->cwnd -= 1.0 / cc->cwnd;
+    }
+}
+
+static void delay_on_loss(CongestionControl *cc, int timeout, double now)
+{
+    (void)now;
+    cc->ssthresh = fmax(cc->cwnd * 0.75, 2.0);
+    cc->cwnd = timeout ? fmax(cc->cwnd / 2.0, 1.0) : cc->ssthresh;
+}
+
+static const CongestionOps cc_algorithms[] = {
+    { "reno",  reno_on_ack,  reno_on_loss  },
+    { "cubic", cubic_on_ack, cubic_on_loss },
+    { "delay", delay_on_ack, delay_on_loss },
+};
+
+// Busca algoritmo pelo nome (NULL se desconhecido)
+static const CongestionOps *cc_find(const char *name)
+{
+    for (size_t i = 0; i < sizeof(cc_algorithms) / sizeof(cc_algorithms[0]); i++) {
+        if (strcmp(cc_algorithms[i].name, name) == 0) return &cc_algorithms[i];
+    }
+    return NULL;
+}
+
+static void cc_init(CongestionControl *cc, const CongestionOps *ops, int max_window)
+{
+    memset(cc, 0, sizeof(*cc));
+    cc->ops = ops ? ops : &cc_algorithms[0];
+    cc->cwnd = INITIAL_CWND;
+    cc->ssthresh = max_window;
+    cc->max_window = max_window;
+    cc->recovery_seq = -1;
+}
+
+// Janela efetiva em pacotes
+static int cc_window(const CongestionControl *cc)
+{
+    int w = (int)cc->cwnd;
+    if (w < 1) w = 1;
+    if (w > cc->max_window) w = cc->max_window;
+    return w;
+}
+
+static void cc_on_ack(CongestionControl *cc, double rtt, double now)
+{
+    cc->ops->on_ack(cc, rtt, now);
+    if (cc->cwnd > cc->max_window) cc->cwnd = cc->max_window;
+}
+
+// Perda do pacote seq. Perdas rápidas (RACK) reduzem só uma vez por janela
+// (seq abaixo de recovery_seq foi enviado antes da última redução); um RTO
+// sempre reduz, mesmo dentro da janela de uma redução rápida anterior
+static void cc_on_loss(CongestionControl *cc, int seq, int next_seq, int timeout, double now)
+{
+    if (!timeout && seq < cc->recovery_seq) return;
+    cc->recovery_seq = next_seq;
+    cc->ops->on_loss(cc, timeout, now);
+    if (cc->cwnd < 1.0) cc->cwnd = 1.0;
+}
+
+#endif
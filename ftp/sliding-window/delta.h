@@ -0,0 +1,406 @@
+/*
+    Upload por delta (estilo rsync) para arquivos que já existem no servidor
+    Compartilhado por client.cpp (delta) e server.cpp (assinatura e aplicação)
+
+    1. O servidor divide received_<nome> em blocos de DELTA_BLOCK bytes e
+       devolve a assinatura: por bloco um checksum fraco rolante e um hash
+       forte de 64 bits.
+    2. O cliente percorre o arquivo local com a janela rolante: a cada byte o
+       checksum fraco é atualizado em O(1) e, se existir na assinatura, o hash
+       forte confirma o bloco. O delta é uma sequência de referências a blocos
+       do servidor e de trechos literais (só o que mudou).
+    3. O servidor remonta o arquivo num temporário a partir da versão atual e
+       do delta, confere tamanho e hash do arquivo inteiro (o mesmo da retomada,
+       ver ../checkpoint.h) e só então o renomeia sobre received_<nome>.
+
+    Assinatura e delta trafegam como arquivos comuns pela janela deslizante;
+    todos os inteiros em ordem de rede:
+        assinatura: "FSG1", u32 tamanho do bloco, u64 tamanho, u32 blocos,
+                    e por bloco u32 fraco + u64 forte (só blocos inteiros)
+        delta:      "FDL1", u32 tamanho do bloco, u64 tamanho final, u32 hash,
+                    e operações 'L' u32 n + n bytes | 'C' u32 bloco + u32 quantos
+*/
+#ifndef FTP_DELTA_H
+#define FTP_DELTA_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "../protocol.h"
+#include "../checkpoint.h"
+
+#define DELTA_BLOCK 4096               // Granularidade das referências (4 pacotes)
+#define DELTA_MAX_LITERAL 65536        // Literal maior é dividido em várias operações
+#define DELTA_SIG_MAGIC "FSG1"
+#define DELTA_MAGIC "FDL1"
+#define DELTA_OP_LITERAL 'L'
+#define DELTA_OP_COPY 'C'
+
+// Mensagem de ERROR do servidor em resposta ao END de um delta inaplicável
+#define DELTA_FAILED_MSG "Delta nao pode ser aplicado"
+
+// Estatísticas do delta gerado pelo cliente
+typedef struct {
+    long long literal_bytes;
+    long long copied_bytes;
+    int copy_ops;
+} DeltaStats;
+
+// Checksum fraco rolante (rsync): a = soma dos bytes, b = soma ponderada,
+// ambos módulo 2^16 (a aritmética em 32 bits já é consistente módulo 2^16)
+static inline uint32_t delta_weak(const unsigned char *p, int len, uint32_t *a, uint32_t *b)
+{
+    uint32_t sa = 0, sb = 0;
+    for (int i = 0; i < len; i++) {
+        sa += p[i];
+        sb += (uint32_t)(len - i) * p[i];
+    }
+    *a = sa;
+    *b = sb;
+    return (sa & 0xffff) | (sb << 16);
+}
+
+// Desliza a janela um byte: sai out, entra in
+static inline uint32_t delta_roll(uint32_t *a, uint32_t *b, int len, unsigned char out, unsigned char in)
+{
+    *a = *a - out + in;
+    *b = *b - (uint32_t)len * out + *a;
+    return (*a & 0xffff) | (*b << 16);
+}
+
+// Hash forte do bloco: FNV-1a de 64 bits aplicado por palavra de 8 bytes
+static inline uint64_t delta_strong(const unsigned char *p, int len)
+{
+    uint64_t h = 14695981039346656037ull ^ (uint64_t)len;
+    int i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, p + i, 8);
+        h = (h ^ w) * 1099511628211ull;
+        h ^= h >> 29;
+    }
+    for (; i < len; i++) {
+        h = (h ^ p[i]) * 1099511628211ull;
+    }
+    return h;
+}
+
+static inline void delta_put32(FILE *f, uint32_t v)
+{
+    uint32_t n = htonl(v);
+    fwrite(&n, 4, 1, f);
+}
+
+static inline void delta_put64(FILE *f, uint64_t v)
+{
+    delta_put32(f, (uint32_t)(v >> 32));
+    delta_put32(f, (uint32_t)v);
+}
+
+static inline int delta_get32(FILE *f, uint32_t *v)
+{
+    uint32_t n;
+    if (fread(&n, 4, 1, f) != 1) return -1;
+    *v = ntohl(n);
+    return 0;
+}
+
+static inline int delta_get64(FILE *f, uint64_t *v)
+{
+    uint32_t hi, lo;
+    if (delta_get32(f, &hi) == -1 || delta_get32(f, &lo) == -1) return -1;
+    *v = ((uint64_t)hi << 32) | lo;
+    return 0;
+}
+
+// Servidor: assinatura do arquivo aberto em fd num temporário anônimo.
+// Retorna o descritor do temporário (posicionado no início) ou -1
+static inline int delta_signature(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) == -1) return -1;
+    FILE *out = tmpfile();
+    if (!out) return -1;
+
+    uint32_t blocks = (uint32_t)(st.st_size / DELTA_BLOCK);
+    fwrite(DELTA_SIG_MAGIC, 4, 1, out);
+    delta_put32(out, DELTA_BLOCK);
+    delta_put64(out, (uint64_t)st.st_size);
+    delta_put32(out, blocks);
+
+    unsigned char block[DELTA_BLOCK];
+    for (uint32_t i = 0; i < blocks; i++) {
+        if (pread(fd, block, DELTA_BLOCK, (off_t)i * DELTA_BLOCK) != DELTA_BLOCK) {
+            fclose(out);
+            return -1;
+        }
+        uint32_t a, b;
+        delta_put32(out, delta_weak(block, DELTA_BLOCK, &a, &b));
+        delta_put64(out, delta_strong(block, DELTA_BLOCK));
+    }
+
+    // O descritor duplicado mantém o temporário vivo depois do fclose
+    int sig_fd = fflush(out) == 0 ? dup(fileno(out)) : -1;
+    fclose(out);
+    if (sig_fd != -1) lseek(sig_fd, 0, SEEK_SET);
+    return sig_fd;
+}
+
+// Assinatura carregada pelo cliente, com tabela hash pelo checksum fraco
+typedef struct {
+    int blocks;
+    uint32_t *weak;
+    uint64_t *strong;
+    int *heads;                        // Primeiro bloco de cada balde (-1: vazio)
+    int *next;                         // Próximo bloco com o mesmo balde
+    uint32_t mask;
+} DeltaSignature;
+
+static inline void delta_signature_free(DeltaSignature *sig)
+{
+    free(sig->weak);
+    free(sig->strong);
+    free(sig->heads);
+    free(sig->next);
+    memset(sig, 0, sizeof(*sig));
+}
+
+// Cliente: lê a assinatura recebida em fd; -1 se estiver corrompida
+static inline int delta_signature_load(int fd, DeltaSignature *sig)
+{
+    memset(sig, 0, sizeof(*sig));
+    FILE *in = fdopen(dup(fd), "rb");
+    if (!in) return -1;
+    rewind(in);
+
+    char magic[4];
+    uint32_t block_size, blocks;
+    uint64_t size;
+    if (fread(magic, 4, 1, in) != 1 || memcmp(magic, DELTA_SIG_MAGIC, 4) != 0 ||
+        delta_get32(in, &block_size) == -1 || block_size != DELTA_BLOCK ||
+        delta_get64(in, &size) == -1 || delta_get32(in, &blocks) == -1 ||
+        blocks != size / DELTA_BLOCK) {
+        fclose(in);
+        return -1;
+    }
+
+    uint32_t buckets = 1;
+    while (buckets < 2 * blocks) buckets <<= 1;
+    sig->blocks = (int)blocks;
+    sig->mask = buckets - 1;
+    sig->weak = (uint32_t*)malloc((blocks + 1) * sizeof(uint32_t));
+    sig->strong = (uint64_t*)malloc((blocks + 1) * sizeof(uint64_t));
+    sig->next = (int*)malloc((blocks + 1) * sizeof(int));
+    sig->heads = (int*)malloc(buckets * sizeof(int));
+    if (!sig->weak || !sig->strong || !sig->next || !sig->heads) {
+        fclose(in);
+        delta_signature_free(sig);
+        return -1;
+    }
+    memset(sig->heads, 0xff, buckets * sizeof(int));
+
+    for (uint32_t i = 0; i < blocks; i++) {
+        if (delta_get32(in, &sig->weak[i]) == -1 || delta_get64(in, &sig->strong[i]) == -1) {
+            fclose(in);
+            delta_signature_free(sig);
+            return -1;
+        }
+    }
+    fclose(in);
+
+    // Inserção em ordem decrescente: cada balde começa pelo menor bloco
+    for (int i = (int)blocks - 1; i >= 0; i--) {
+        uint32_t bucket = (sig->weak[i] * 0x9e3779b1u) & sig->mask;
+        sig->next[i] = sig->heads[bucket];
+        sig->heads[bucket] = i;
+    }
+    return 0;
+}
+
+// Bloco da assinatura igual à janela em p (preferindo want, o seguinte ao
+// último copiado); -1 se nenhum
+static inline int delta_match(const DeltaSignature *sig, uint32_t weak, const unsigned char *p, int want)
+{
+    if (sig->blocks == 0) return -1;
+    uint64_t strong = 0;
+    int computed = 0;
+
+    if (want >= 0 && want < sig->blocks && sig->weak[want] == weak) {
+        strong = delta_strong(p, DELTA_BLOCK);
+        computed = 1;
+        if (sig->strong[want] == strong) return want;
+    }
+    for (int i = sig->heads[(weak * 0x9e3779b1u) & sig->mask]; i != -1; i = sig->next[i]) {
+        if (sig->weak[i] != weak) continue;
+        if (!computed) {
+            strong = delta_strong(p, DELTA_BLOCK);
+            computed = 1;
+        }
+        if (sig->strong[i] == strong) return i;
+    }
+    return -1;
+}
+
+static inline void delta_emit_literal(FILE *out, const unsigned char *p, long long len, DeltaStats *stats)
+{
+    while (len > 0) {
+        uint32_t n = len > DELTA_MAX_LITERAL ? DELTA_MAX_LITERAL : (uint32_t)len;
+        fputc(DELTA_OP_LITERAL, out);
+        delta_put32(out, n);
+        fwrite(p, 1, n, out);
+        stats->literal_bytes += n;
+        p += n;
+        len -= n;
+    }
+}
+
+static inline void delta_emit_copy(FILE *out, int first, int count, DeltaStats *stats)
+{
+    if (count == 0) return;
+    fputc(DELTA_OP_COPY, out);
+    delta_put32(out, (uint32_t)first);
+    delta_put32(out, (uint32_t)count);
+    stats->copied_bytes += (long long)count * DELTA_BLOCK;
+    stats->copy_ops++;
+}
+
+// Cliente: delta de data[0, size) contra a assinatura, escrito em out.
+// new_hash é o hash do arquivo inteiro, conferido pelo servidor no fim
+static inline void delta_build(const DeltaSignature *sig, const unsigned char *data, long long size,
+                               uint32_t new_hash, FILE *out, DeltaStats *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    fwrite(DELTA_MAGIC, 4, 1, out);
+    delta_put32(out, DELTA_BLOCK);
+    delta_put64(out, (uint64_t)size);
+    delta_put32(out, new_hash);
+
+    long long pos = 0, literal_start = 0;
+    int run_first = -1, run_count = 0;     // Referências consecutivas acumuladas
+    uint32_t a = 0, b = 0, weak = 0;
+    int rolling = 0;                       // weak vale para a janela em pos
+
+    while (pos + DELTA_BLOCK <= size) {
+        if (!rolling) {
+            weak = delta_weak(data + pos, DELTA_BLOCK, &a, &b);
+            rolling = 1;
+        }
+
+        int want = run_first >= 0 ? run_first + run_count : -1;
+        int block = delta_match(sig, weak, data + pos, want);
+        if (block >= 0) {
+            delta_emit_literal(out, data + literal_start, pos - literal_start, stats);
+            if (block != want) {
+                delta_emit_copy(out, run_first, run_count, stats);
+                run_first = block;
+                run_count = 0;
+            }
+            run_count++;
+            pos += DELTA_BLOCK;
+            literal_start = pos;
+            rolling = 0;
+            continue;
+        }
+
+        // Sem bloco igual: o byte vira literal (o que encerra a sequência de
+        // referências) e a janela anda um byte
+        if (pos == literal_start) {
+            delta_emit_copy(out, run_first, run_count, stats);
+            run_first = -1;
+            run_count = 0;
+        }
+        if (pos + DELTA_BLOCK < size) {
+            weak = delta_roll(&a, &b, DELTA_BLOCK, data[pos], data[pos + DELTA_BLOCK]);
+        }
+        pos++;
+
+        // Literal longo sai em partes, sem esperar o próximo bloco igual
+        if (pos - literal_start >= DELTA_MAX_LITERAL) {
+            delta_emit_literal(out, data + literal_start, pos - literal_start, stats);
+            literal_start = pos;
+        }
+    }
+
+    delta_emit_copy(out, run_first, run_count, stats);
+    delta_emit_literal(out, data + literal_start, size - literal_start, stats);
+}
+
+// Servidor: remonta em out_path o arquivo descrito pelo delta (lido de
+// delta_fd) a partir de basis_fd. Retorna o tamanho final ou -1 (delta
+// inválido, referência fora da base ou hash final divergente)
+static inline long long delta_apply(int basis_fd, int delta_fd, const char *out_path)
+{
+    FILE *in = fdopen(dup(delta_fd), "rb");
+    if (!in) return -1;
+    rewind(in);
+
+    char magic[4];
+    uint32_t block_size, new_hash;
+    uint64_t new_size;
+    if (fread(magic, 4, 1, in) != 1 || memcmp(magic, DELTA_MAGIC, 4) != 0 ||
+        delta_get32(in, &block_size) == -1 || block_size != DELTA_BLOCK ||
+        delta_get64(in, &new_size) == -1 || delta_get32(in, &new_hash) == -1) {
+        fclose(in);
+        return -1;
+    }
+
+    struct stat st;
+    int out = open(out_path, O_RDWR | O_CREAT | O_TRUNC, 0666);   // relido no hash final
+    if (out == -1 || fstat(basis_fd, &st) == -1) {
+        if (out != -1) close(out);
+        fclose(in);
+        return -1;
+    }
+    long long basis_blocks = st.st_size / DELTA_BLOCK;
+
+    static const int chunk_blocks = DELTA_MAX_LITERAL / DELTA_BLOCK;
+    unsigned char *buf = (unsigned char*)malloc(DELTA_MAX_LITERAL);
+    long long written = 0;
+    int ok = buf != NULL;
+    int op;
+
+    while (ok && (op = fgetc(in)) != EOF) {
+        uint32_t x, y;
+        if (op == DELTA_OP_LITERAL) {
+            ok = delta_get32(in, &x) == 0 && x <= DELTA_MAX_LITERAL &&
+                 fread(buf, 1, x, in) == x && write(out, buf, x) == (ssize_t)x;
+            written += x;
+        } else if (op == DELTA_OP_COPY) {
+            ok = delta_get32(in, &x) == 0 && delta_get32(in, &y) == 0 &&
+                 (long long)x + y <= basis_blocks;
+            // Blocos da versão atual copiados em trechos de até DELTA_MAX_LITERAL
+            for (uint32_t done = 0; ok && done < y; ) {
+                uint32_t n = y - done < (uint32_t)chunk_blocks ? y - done : (uint32_t)chunk_blocks;
+                ssize_t len = (ssize_t)n * DELTA_BLOCK;
+                ok = pread(basis_fd, buf, len, (off_t)(x + done) * DELTA_BLOCK) == len &&
+                     write(out, buf, len) == len;
+                written += len;
+                done += n;
+            }
+        } else {
+            ok = 0;
+        }
+    }
+    free(buf);
+    fclose(in);
+
+    // Confere o resultado inteiro antes de substituir a versão atual
+    uint32_t hash;
+    int packets = (int)((written + BUFLEN - 1) / BUFLEN);
+    if (ok) ok = (uint64_t)written == new_size && fsync(out) == 0;
+    if (ok) ok = resume_hash_file(out, packets, &hash) == 0 && hash == new_hash;
+    close(out);
+    if (!ok) {
+        unlink(out_path);
+        return -1;
+    }
+    return written;
+}
+
+#endif
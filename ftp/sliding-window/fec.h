@@ -0,0 +1,446 @@
+/*
+    Correção de erros à frente (FEC) do Selective Repeat
+    Compartilhado por server.cpp e client.cpp: remetente com --fec (download
+    no servidor, upload no cliente); os receptores sempre reconstroem
+
+    Em enlaces sem fio com perda aleatória cada pacote perdido custa pelo
+    menos um RTT (RACK) e, na cauda, um probe ou um RTO. Com --fec o
+    remetente agrupa os pacotes novos em blocos de até FEC_BLOCK e, ao fechar
+    cada bloco, envia m pacotes de paridade (PKT_FEC, ver ../protocol.h). O
+    receptor reconstrói até m perdas do bloco sem esperar retransmissão.
+
+    Código: Reed-Solomon sistemático sobre GF(2^8) com matriz de Cauchy,
+    normalizada para que a primeira linha seja só de uns. Com m = 1 a paridade
+    é o XOR do bloco (sem multiplicações); com m > 1 quaisquer m perdas são
+    recuperáveis, pois toda submatriz quadrada de uma matriz de Cauchy é
+    inversível. O coeficiente depende só da linha e da posição no bloco, então
+    o receptor não precisa saber m.
+
+    O remetente acumula a paridade à medida que os pacotes saem (m·BUFLEN por
+    sessão). O receptor guarda só as paridades dos blocos com perdas e relê do
+    arquivo (pread) os pacotes já gravados: o destino é aberto para leitura e
+    escrita. Todos os pacotes do bloco têm BUFLEN bytes, exceto o último do
+    arquivo, cujo tamanho vai no próprio pacote de paridade.
+
+    Redundância adaptativa: o receptor devolve nos ACKs (campo próprio no
+    bloco de extensão, ver ../protocol.h) o total de pacotes que reconstruiu; o remetente soma a isso as perdas que
+    retransmitiu e, a cada FEC_SAMPLE pacotes, atualiza a média móvel da taxa
+    de perda p. Cada bloco novo leva m = k·p mais dois desvios padrão da
+    binomial, de 0 (p < FEC_OFF_LOSS: sem paridade) a FEC_MAX_M.
+    Perdas reconstruídas não reduzem a cwnd: no enlace sem fio a perda
+    aleatória não indica congestionamento. As paridades, por outro lado,
+    ocupam a cwnd como os pacotes de dados até o bloco ser confirmado
+    (sender.h), além de pagar fichas do pacer.
+
+    Para o RACK (loss_recovery.h) um pacote de bloco com paridade conta como
+    enviado junto com a paridade (fec_rack_time): a retransmissão rápida só
+    dispara depois do RTT em que o receptor já poderia tê-lo reconstruído.
+*/
+#ifndef FTP_FEC_H
+#define FTP_FEC_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../protocol.h"
+#include "../checksum.h"
+#include "../batch_io.h"
+#include "../log.h"
+#include "../rtt.h"
+#include "file_sink.h"
+
+#define FEC_BLOCK 16                // Pacotes de dados por bloco
+#define FEC_MAX_M 8                 // Paridades por bloco no máximo
+#define FEC_SLOTS 16                // Blocos com perdas aguardando paridade (receptor)
+#define FEC_SAMPLE 128              // Pacotes enviados por amostra da taxa de perda
+#define FEC_INITIAL_LOSS 0.01       // Antes da primeira amostra (m = 1: XOR)
+#define FEC_OFF_LOSS 0.002          // Abaixo disto o bloco sai sem paridade
+#define FEC_TIMES (MAX_WINDOW / FEC_BLOCK + 2)  // Blocos em voo com instante da paridade
+
+// Paridade nos envios (--fec)
+static int fec_enabled = 0;
+
+// ═══ GF(2^8), polinômio 0x11d ═══
+static unsigned char gf_exp[510];
+static unsigned char gf_log[256];
+static unsigned char gf_mul_table[256][256];
+static unsigned char fec_coef[FEC_MAX_M][FEC_BLOCK];    // Linha j, posição i
+static pthread_once_t fec_once = PTHREAD_ONCE_INIT;
+
+static void fec_tables_init()
+{
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = gf_exp[i + 255] = (unsigned char)x;
+        gf_log[x] = (unsigned char)i;
+        x <<= 1;
+        if (x & 0x100) x ^= 0x11d;
+    }
+    for (int a = 1; a < 256; a++) {
+        for (int b = 1; b < 256; b++) {
+            gf_mul_table[a][b] = gf_exp[gf_log[a] + gf_log[b]];
+        }
+    }
+
+    // Cauchy 1/(x_j + y_i) com x_j = j e y_i = FEC_MAX_M + i, cada coluna
+    // dividida pela da linha 0: (x_0 + y_i)/(x_j + y_i)
+    for (int j = 0; j < FEC_MAX_M; j++) {
+        for (int i = 0; i < FEC_BLOCK; i++) {
+            int y = FEC_MAX_M + i;
+            fec_coef[j][i] = gf_exp[gf_log[y] + 255 - gf_log[j ^ y]];
+        }
+    }
+}
+
+static inline unsigned char gf_inv(unsigned char a)
+{
+    return gf_exp[255 - gf_log[a]];
+}
+
+// dst ^= c · src (len bytes)
+static void gf_mul_add(unsigned char *dst, const unsigned char *src, int len, unsigned char c)
+{
+    if (c == 0) return;
+    if (c == 1) {
+        for (int i = 0; i < len; i++) dst[i] ^= src[i];
+        return;
+    }
+    const unsigned char *row = gf_mul_table[c];
+    for (int i = 0; i < len; i++) dst[i] ^= row[src[i]];
+}
+
+// Inverte a matriz n×n a (destruída) em inv; -1 se for singular
+static int gf_invert(unsigned char a[FEC_MAX_M][FEC_MAX_M], unsigned char inv[FEC_MAX_M][FEC_MAX_M], int n)
+{
+    memset(inv, 0, sizeof(unsigned char) * FEC_MAX_M * FEC_MAX_M);
+    for (int i = 0; i < n; i++) inv[i][i] = 1;
+
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        while (pivot < n && a[pivot][col] == 0) pivot++;
+        if (pivot == n) return -1;
+        for (int x = 0; x < n; x++) {
+            unsigned char t = a[col][x]; a[col][x] = a[pivot][x]; a[pivot][x] = t;
+            t = inv[col][x]; inv[col][x] = inv[pivot][x]; inv[pivot][x] = t;
+        }
+
+        unsigned char f = gf_inv(a[col][col]);
+        for (int x = 0; x < n; x++) {
+            a[col][x] = gf_mul_table[f][a[col][x]];
+            inv[col][x] = gf_mul_table[f][inv[col][x]];
+        }
+        for (int row = 0; row < n; row++) {
+            unsigned char c = a[row][col];
+            if (row == col || c == 0) continue;
+            for (int x = 0; x < n; x++) {
+                a[row][x] ^= gf_mul_table[c][a[col][x]];
+                inv[row][x] ^= gf_mul_table[c][inv[col][x]];
+            }
+        }
+    }
+    return 0;
+}
+
+// ═══ Remetente ═══
+typedef struct {
+    int origin;                         // Primeiro seq enviado (-1: nenhum); blocos contam dele
+    int start;                          // Primeiro seq do bloco aberto
+    int count;                          // Pacotes já somados ao bloco (0: nenhum aberto)
+    int m;                              // Paridades do bloco aberto
+    int last_len;                       // Payload do último pacote somado
+    unsigned char parity[FEC_MAX_M][BUFLEN];
+    long long parity_ns[FEC_TIMES];     // Envio das paridades de cada bloco (0: sem paridade)
+    double loss;                        // Taxa de perda estimada (média móvel)
+    int sent;                           // Pacotes desde a última amostra
+    int lost;                           // Retransmissões por perda desde a última amostra
+    uint32_t recovered;                 // Total reconstruído informado pelo receptor
+    uint32_t recovered_seen;            // ... na última amostra
+    unsigned long long packets;         // Pacotes de dados (resumo)
+    unsigned long long parities;        // Pacotes de paridade (resumo)
+} FecEncoder;
+
+static FecEncoder *fec_encoder_new()
+{
+    pthread_once(&fec_once, fec_tables_init);
+    FecEncoder *enc = (FecEncoder*)calloc(1, sizeof(FecEncoder));
+    if (enc) {
+        enc->origin = -1;
+        enc->loss = FEC_INITIAL_LOSS;
+    }
+    return enc;
+}
+
+// Paridades para k pacotes com taxa de perda p
+static int fec_redundancy(double p, int k)
+{
+    if (p < FEC_OFF_LOSS) return 0;
+    double mean = k * p;
+    int m = (int)ceil(mean + 2 * sqrt(mean * (1 - p)));
+    if (m < 1) m = 1;
+    if (m > FEC_MAX_M) m = FEC_MAX_M;
+    return m;
+}
+
+// Fecha uma amostra: perdas retransmitidas + reconstruídas pelo receptor
+static void fec_update_loss(FecEncoder *enc)
+{
+    if (enc->sent < FEC_SAMPLE) return;
+    double sample = (double)(enc->lost + (enc->recovered - enc->recovered_seen)) / enc->sent;
+    if (sample > 1) sample = 1;
+
+    int old_m = fec_redundancy(enc->loss, FEC_BLOCK);
+    enc->loss = (enc->loss + sample) / 2;
+    int m = fec_redundancy(enc->loss, FEC_BLOCK);
+    if (m != old_m) {
+        LOG(LOG_INFO, "  🛡️  FEC: perda estimada %.1f%%, %d paridades por bloco de %d\n",
+            enc->loss * 100, m, FEC_BLOCK);
+    }
+    enc->sent = 0;
+    enc->lost = 0;
+    enc->recovered_seen = enc->recovered;
+}
+
+// Pacote novo seq (last_seq: último do arquivo) entra no bloco aberto; ao
+// fechar o bloco as paridades vão para a rajada b. Retorna os bytes de
+// paridade enfileirados, para o pacer
+static int fec_on_send(FecEncoder *enc, int sockfd, PacketBatch *b, uint32_t session_id,
+                       int seq, const unsigned char *payload, int len, int last_seq,
+                       const struct sockaddr_in *addr, socklen_t addr_len)
+{
+    if (enc->origin < 0) enc->origin = seq;
+    if (enc->count == 0) {
+        fec_update_loss(enc);
+        enc->start = seq;
+        enc->m = fec_redundancy(enc->loss, FEC_BLOCK);
+        memset(enc->parity, 0, (size_t)enc->m * BUFLEN);
+    }
+    for (int j = 0; j < enc->m; j++) {
+        gf_mul_add(enc->parity[j], payload, len, fec_coef[j][enc->count]);
+    }
+    enc->count++;
+    enc->last_len = len;
+    enc->sent++;
+    enc->packets++;
+    if (enc->count < FEC_BLOCK && seq < last_seq) return 0;
+
+    // Bloco fechado: payload da paridade do tamanho do maior pacote
+    int k = enc->count;
+    enc->parity_ns[(enc->start - enc->origin) / FEC_BLOCK % FEC_TIMES] = enc->m > 0 ? now_ns() : 0;
+    int plen = k > 1 ? BUFLEN : len;
+    Packet pkt;
+    memset(&pkt, 0, sizeof(Packet));
+    pkt.type = PKT_FEC;
+    pkt.session_id = session_id;
+    pkt.seq_num = enc->start;
+    pkt.data_len = plen;
+    pkt.fec_k = k;
+    pkt.fec_last_len = enc->last_len;
+    for (int j = 0; j < enc->m; j++) {
+        pkt.fec_index = j;
+        memcpy(pkt.data, enc->parity[j], plen);
+        pkt.checksum = calculate_checksum(pkt.data, plen);
+        batch_add(sockfd, b, &pkt, addr, addr_len);
+    }
+    enc->parities += enc->m;
+    enc->count = 0;
+    return enc->m * plen;
+}
+
+// Instante de envio de seq para o RACK: o das paridades do bloco, se vieram
+// depois (xmit_ns: último envio do próprio pacote)
+static inline long long fec_rack_time(const FecEncoder *enc, int seq, long long xmit_ns)
+{
+    if (enc->origin < 0 || seq < enc->origin || (enc->count > 0 && seq >= enc->start)) return xmit_ns;
+    long long parity_ns = enc->parity_ns[(seq - enc->origin) / FEC_BLOCK % FEC_TIMES];
+    return parity_ns > xmit_ns ? parity_ns : xmit_ns;
+}
+
+// Retransmissão por perda (RACK ou RTO)
+static inline void fec_on_loss(FecEncoder *enc)
+{
+    enc->lost++;
+}
+
+// Total de reconstruções do ACK; ignora ACKs atrasados e campos que não
+// podem ser contagem (mais reconstruções do que pacotes enviados)
+static inline void fec_on_ack(FecEncoder *enc, uint32_t recovered)
+{
+    uint32_t delta = recovered - enc->recovered;
+    if ((int32_t)delta > 0 && delta <= enc->packets) enc->recovered = recovered;
+}
+
+static void fec_encoder_report(const char *tag, const FecEncoder *enc)
+{
+    if (!enc || enc->packets == 0) return;
+    printf("%s🛡️  FEC: %llu pacotes de paridade (+%.1f%%), %u reconstruídos no receptor, perda estimada %.1f%%\n",
+           tag, enc->parities, 100.0 * enc->parities / enc->packets, enc->recovered, enc->loss * 100);
+}
+
+// ═══ Receptor ═══
+typedef struct {
+    int start;                          // Primeiro seq do bloco (-1: livre)
+    int k;
+    int last_len;
+    int count;                          // Paridades guardadas
+    unsigned char index[FEC_MAX_M];     // Linha de cada paridade
+    unsigned char parity[FEC_MAX_M][BUFLEN];
+} FecBlock;
+
+typedef struct {
+    FecBlock blocks[FEC_SLOTS];
+    uint32_t recovered;                 // Total reconstruído (vai nos ACKs)
+} FecDecoder;
+
+// Total para o campo fec_recovered dos ACKs (sem decodificador: nenhum)
+static inline uint32_t fec_recovered(const FecDecoder *dec)
+{
+    return dec ? dec->recovered : 0;
+}
+
+// Pacotes do bloco ainda não recebidos, em lost (posições no bloco)
+static int fec_missing(const FileSink *sink, int start, int k, int *lost)
+{
+    int n = 0;
+    for (int i = 0; i < k; i++) {
+        int seq = start + i;
+        if (seq >= sink->base && !sink_has(sink, seq)) {
+            if (lost) lost[n] = i;
+            n++;
+        }
+    }
+    return n;
+}
+
+// Posição para o bloco start: a dele, uma livre, uma já completa ou a mais antiga
+static FecBlock *fec_block_slot(FecDecoder *dec, const FileSink *sink, int start)
+{
+    for (int i = 0; i < FEC_SLOTS; i++) {
+        if (dec->blocks[i].start == start) return &dec->blocks[i];
+    }
+
+    FecBlock *slot = &dec->blocks[0];
+    for (int i = 0; i < FEC_SLOTS; i++) {
+        FecBlock *b = &dec->blocks[i];
+        if (b->start == -1 || b->start + b->k <= sink->base) {
+            slot = b;
+            break;
+        }
+        if (b->start < slot->start) slot = b;
+    }
+    slot->start = -1;
+    slot->count = 0;
+    return slot;
+}
+
+// Resolve o bloco b (perdas <= paridades guardadas) e entrega os pacotes
+// reconstruídos ao sink. Retorna quantos foram reconstruídos
+static int fec_recover(FecDecoder *dec, FecBlock *b, FileSink *sink, uint32_t session_id)
+{
+    int lost[FEC_MAX_M];
+    int e = fec_missing(sink, b->start, b->k, lost);
+    int plen = b->k > 1 ? BUFLEN : b->last_len;
+
+    // Síndromes: cada paridade menos a contribuição dos pacotes já gravados
+    unsigned char data[BUFLEN];
+    for (int i = 0, l = 0; i < b->k; i++) {
+        if (l < e && lost[l] == i) {
+            l++;
+            continue;
+        }
+        int len = i == b->k - 1 ? b->last_len : BUFLEN;
+        if (pread(sink->fd, data, len, (off_t)(b->start + i) * BUFLEN) != len) {
+            perror("pread");
+            b->start = -1;
+            return 0;
+        }
+        for (int r = 0; r < e; r++) gf_mul_add(b->parity[r], data, len, fec_coef[b->index[r]][i]);
+    }
+
+    // Sistema e×e das posições perdidas nas linhas das paridades
+    unsigned char a[FEC_MAX_M][FEC_MAX_M], inv[FEC_MAX_M][FEC_MAX_M];
+    for (int r = 0; r < e; r++) {
+        for (int l = 0; l < e; l++) a[r][l] = fec_coef[b->index[r]][lost[l]];
+    }
+    if (gf_invert(a, inv, e) == -1) {
+        b->start = -1;
+        return 0;
+    }
+
+    Packet pkt;
+    memset(&pkt, 0, sizeof(Packet));
+    pkt.type = PKT_DATA;
+    pkt.session_id = session_id;
+    for (int l = 0; l < e; l++) {
+        memset(data, 0, plen);
+        for (int r = 0; r < e; r++) gf_mul_add(data, b->parity[r], plen, inv[l][r]);
+
+        pkt.seq_num = b->start + lost[l];
+        pkt.data_len = lost[l] == b->k - 1 ? b->last_len : BUFLEN;
+        memcpy(pkt.data, data, pkt.data_len);
+        pkt.checksum = calculate_checksum(pkt.data, pkt.data_len);
+        sink_on_data(sink, &pkt);
+        LOG(LOG_PACKET, "%s🛡️  Reconstruído seq=%d (bloco %d, %d paridades)\n",
+            sink->tag, pkt.seq_num, b->start, e);
+    }
+    b->start = -1;
+    dec->recovered += e;
+    return e;
+}
+
+// Trata um pacote FEC: guarda a paridade se o bloco tem perdas e reconstrói
+// quando há paridades suficientes (*dec é alocado na primeira perda).
+// Retorna quantos pacotes foram reconstruídos
+static int fec_on_parity(FecDecoder **dec, FileSink *sink, const Packet *pkt)
+{
+    int start = pkt->seq_num, k = pkt->fec_k;
+    if (k < 1 || k > FEC_BLOCK || pkt->fec_index >= FEC_MAX_M ||
+        pkt->fec_last_len < 1 || pkt->fec_last_len > BUFLEN ||
+        pkt->data_len != (k > 1 ? BUFLEN : pkt->fec_last_len)) {
+        return 0;
+    }
+    if (calculate_checksum(pkt->data, pkt->data_len) != pkt->checksum) {
+        LOG(LOG_WARN, "%s❌ Checksum inválido na paridade do bloco %d\n", sink->tag, start);
+        return 0;
+    }
+
+    // Além da janela o bitmap não distingue os pacotes (ver file_sink.h)
+    if (start + k > sink->base + MAX_WINDOW) return 0;
+    if (fec_missing(sink, start, k, NULL) == 0) return 0;
+
+    if (!*dec) {
+        pthread_once(&fec_once, fec_tables_init);
+        *dec = (FecDecoder*)calloc(1, sizeof(FecDecoder));
+        if (!*dec) return 0;
+        for (int i = 0; i < FEC_SLOTS; i++) (*dec)->blocks[i].start = -1;
+    }
+
+    FecBlock *b = fec_block_slot(*dec, sink, start);
+    for (int r = 0; r < b->count; r++) {
+        if (b->index[r] == pkt->fec_index) return 0;     // Duplicata
+    }
+    b->start = start;
+    b->k = k;
+    b->last_len = pkt->fec_last_len;
+    b->index[b->count] = (unsigned char)pkt->fec_index;
+    memcpy(b->parity[b->count], pkt->data, pkt->data_len);
+    b->count++;
+
+    if (b->count < fec_missing(sink, start, k, NULL)) return 0;
+    return fec_recover(*dec, b, sink, pkt->session_id);
+}
+
+// Fim da recepção: resumo e liberação
+static void fec_decoder_finish(FecDecoder *dec, const char *tag)
+{
+    if (!dec) return;
+    if (dec->recovered > 0) {
+        printf("%s🛡️  FEC: %u pacotes reconstruídos sem retransmissão\n", tag, dec->recovered);
+    }
+    free(dec);
+}
+
+#endif
@@ -0,0 +1,306 @@
+/*
+    Cache de arquivos empacotados do servidor
+    Usado por server.cpp (downloads, nos modos com threads e reactor)
+
+    Sem cache cada DOWNLOAD_REQUEST mapeia o arquivo de novo e recalcula o
+    checksum de cada pacote, mesmo com cem clientes baixando o mesmo artefato.
+    Aqui cada arquivo vira uma entrada compartilhada: uma cópia do conteúdo em
+    memória e o checksum de cada pacote, preenchidos sob demanda em segmentos
+    de CACHE_SEGMENT pacotes pela primeira sessão que precisar deles. Depois
+    de pronto, um segmento só é lido (sem lock): as sessões seguintes apontam
+    o anel de envio para os mesmos buffers e reaproveitam os checksums.
+
+    A chave é caminho + dispositivo/inode + mtime + tamanho: um arquivo
+    alterado gera uma entrada nova e a antiga sai da busca, liberada quando a
+    última sessão que a usa terminar (contagem de referências). O total
+    reservado é limitado por --cache <MB>; entradas sem sessões são
+    descartadas da menos usada para a mais usada (LRU) para abrir espaço, e
+    arquivos que não cabem são servidos sem cache, como antes.
+
+    Desligado por padrão: uma entrada é uma segunda cópia do arquivo ao lado
+    do page cache, lida com pread em vez do mapeamento sem cópia de
+    file_source.h. Só compensa quando os mesmos arquivos são baixados muitas
+    vezes; para downloads avulsos o mapeamento direto é mais barato.
+*/
+#ifndef FTP_FILE_CACHE_H
+#define FTP_FILE_CACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../protocol.h"
+#include "../checksum.h"
+
+#define CACHE_SEGMENT 64                // Pacotes preenchidos de uma vez (64 KB)
+
+typedef struct CacheEntry {
+    char path[256];
+    dev_t dev;
+    ino_t ino;
+    long long size;
+    struct timespec mtime;
+    int fd;                             // Cópia do descritor para o preenchimento sob demanda
+    unsigned char *data;                // Conteúdo (size bytes)
+    unsigned int *checksums;            // Um por pacote
+    unsigned char *ready;               // Um por segmento (publicado com release)
+    int segments;
+    int refs;                           // Sessões usando (com cache_lock)
+    int stale;                          // Fora da busca; liberada com refs == 0
+    pthread_mutex_t fill_lock;
+    struct CacheEntry *prev, *next;     // Lista LRU (mais recente primeiro)
+} CacheEntry;
+
+static long long cache_limit = 0;           // --cache <MB>; 0: desligado (padrão)
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static CacheEntry *cache_head = NULL;
+static CacheEntry *cache_tail = NULL;
+static long long cache_bytes = 0;           // Reservado pelas entradas (com as obsoletas)
+static long long cache_resident = 0;        // Já preenchido
+static int cache_entries = 0;
+static unsigned long long cache_hits = 0;
+static unsigned long long cache_misses = 0;
+
+static inline void cache_unlink(CacheEntry *e)
+{
+    if (e->prev) e->prev->next = e->next;
+    else cache_head = e->next;
+    if (e->next) e->next->prev = e->prev;
+    else cache_tail = e->prev;
+    e->prev = e->next = NULL;
+}
+
+static inline void cache_push_front(CacheEntry *e)
+{
+    e->prev = NULL;
+    e->next = cache_head;
+    if (cache_head) cache_head->prev = e;
+    cache_head = e;
+    if (!cache_tail) cache_tail = e;
+}
+
+// Libera a entrada (já fora da lista, sem referências); chamada com cache_lock
+static inline void cache_free(CacheEntry *e)
+{
+    long long filled = 0;
+    for (int i = 0; i < e->segments; i++) {
+        if (!e->ready[i]) continue;
+        long long start = (long long)i * CACHE_SEGMENT * BUFLEN;
+        long long len = e->size - start;
+        filled += len < CACHE_SEGMENT * BUFLEN ? len : CACHE_SEGMENT * BUFLEN;
+    }
+    __atomic_fetch_sub(&cache_resident, filled, __ATOMIC_RELAXED);
+    cache_bytes -= e->size;
+    cache_entries--;
+
+    close(e->fd);
+    pthread_mutex_destroy(&e->fill_lock);
+    free(e->data);
+    free(e->checksums);
+    free(e->ready);
+    free(e);
+}
+
+// Tira da busca; liberada agora ou quando a última sessão terminar
+static inline void cache_retire(CacheEntry *e)
+{
+    cache_unlink(e);
+    e->stale = 1;
+    if (e->refs == 0) cache_free(e);
+}
+
+// Entrada do arquivo path aberto em fd, com uma referência para o chamador;
+// NULL sem cache (desligado, arquivo vazio, não regular ou grande demais).
+// *hit diz se a entrada já existia
+static inline CacheEntry *cache_acquire(const char *path, int fd, int *hit)
+{
+    *hit = 0;
+    struct stat st;
+    if (cache_limit <= 0 || fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+        st.st_size == 0 || st.st_size > cache_limit) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    CacheEntry *e = cache_head;
+    while (e) {
+        CacheEntry *next = e->next;
+        if (strcmp(e->path, path) == 0) {
+            if (e->dev == st.st_dev && e->ino == st.st_ino && e->size == st.st_size &&
+                e->mtime.tv_sec == st.st_mtim.tv_sec && e->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                break;
+            }
+            cache_retire(e);    // Arquivo mudou desde que entrou no cache
+        }
+        e = next;
+    }
+
+    if (e) {
+        cache_unlink(e);
+        cache_push_front(e);
+        e->refs++;
+        cache_hits++;
+        *hit = 1;
+        pthread_mutex_unlock(&cache_lock);
+        return e;
+    }
+    cache_misses++;
+
+    // Abre espaço descartando as menos usadas sem sessões
+    for (CacheEntry *old = cache_tail; old && cache_bytes + st.st_size > cache_limit; ) {
+        CacheEntry *prev = old->prev;
+        if (old->refs == 0) cache_retire(old);
+        old = prev;
+    }
+    if (cache_bytes + st.st_size > cache_limit) {
+        pthread_mutex_unlock(&cache_lock);
+        return NULL;
+    }
+
+    int packets = (int)((st.st_size + BUFLEN - 1) / BUFLEN);
+    int segments = (packets + CACHE_SEGMENT - 1) / CACHE_SEGMENT;
+    e = (CacheEntry*)calloc(1, sizeof(CacheEntry));
+    if (e) {
+        e->data = (unsigned char*)malloc((size_t)st.st_size);
+        e->checksums = (unsigned int*)malloc((size_t)packets * sizeof(unsigned int));
+        e->ready = (unsigned char*)calloc((size_t)segments, 1);
+        e->fd = dup(fd);
+    }
+    if (!e || !e->data || !e->checksums || !e->ready || e->fd == -1) {
+        if (e) {
+            if (e->fd != -1) close(e->fd);
+            free(e->data);
+            free(e->checksums);
+            free(e->ready);
+            free(e);
+        }
+        pthread_mutex_unlock(&cache_lock);
+        return NULL;
+    }
+
+    snprintf(e->path, sizeof(e->path), "%s", path);
+    e->dev = st.st_dev;
+    e->ino = st.st_ino;
+    e->size = st.st_size;
+    e->mtime = st.st_mtim;
+    e->segments = segments;
+    e->refs = 1;
+    pthread_mutex_init(&e->fill_lock, NULL);
+    cache_push_front(e);
+    cache_bytes += e->size;
+    cache_entries++;
+    pthread_mutex_unlock(&cache_lock);
+    return e;
+}
+
+static inline void cache_release(CacheEntry *e)
+{
+    pthread_mutex_lock(&cache_lock);
+    if (--e->refs == 0 && e->stale) cache_free(e);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+// A entrada ainda descreve o arquivo aberto (mesmo tamanho e mtime)
+static inline int cache_current(const CacheEntry *e)
+{
+    struct stat st;
+    return fstat(e->fd, &st) == 0 && st.st_size == e->size &&
+           st.st_mtim.tv_sec == e->mtime.tv_sec && st.st_mtim.tv_nsec == e->mtime.tv_nsec;
+}
+
+// Lê o segmento seg do arquivo e calcula os checksums; -1 se o arquivo
+// encolheu ou foi reescrito depois de entrar no cache. A conferência do
+// mtime vem depois da leitura (a escrita atualiza o mtime antes de copiar os
+// dados), então um segmento nunca mistura versões; a entrada alterada sai da
+// busca e as sessões que já a usam terminam no que foi lido
+static inline int cache_fill(CacheEntry *e, int seg)
+{
+    int ok = 0;
+    pthread_mutex_lock(&e->fill_lock);
+    if (!__atomic_load_n(&e->ready[seg], __ATOMIC_ACQUIRE)) {
+        long long start = (long long)seg * CACHE_SEGMENT * BUFLEN;
+        long long len = e->size - start;
+        if (len > CACHE_SEGMENT * BUFLEN) len = CACHE_SEGMENT * BUFLEN;
+
+        long long done = 0;
+        while (done < len) {
+            ssize_t n = pread(e->fd, e->data + start + done, (size_t)(len - done), (off_t)(start + done));
+            if (n <= 0) break;
+            done += n;
+        }
+        if (done == len && !cache_current(e)) {
+            pthread_mutex_lock(&cache_lock);
+            if (!e->stale) cache_retire(e);
+            pthread_mutex_unlock(&cache_lock);
+            ok = -1;
+        } else if (done == len) {
+            for (long long off = 0; off < len; off += BUFLEN) {
+                int chunk = len - off < BUFLEN ? (int)(len - off) : BUFLEN;
+                e->checksums[(start + off) / BUFLEN] =
+                    calculate_checksum((const char*)e->data + start + off, chunk);
+            }
+            __atomic_store_n(&e->ready[seg], 1, __ATOMIC_RELEASE);
+            __atomic_fetch_add(&cache_resident, len, __ATOMIC_RELAXED);
+        } else {
+            ok = -1;
+        }
+    }
+    pthread_mutex_unlock(&e->fill_lock);
+    return ok;
+}
+
+// Payload e checksum do pacote seq; NULL no fim do arquivo (ou se ele encolheu)
+static inline const unsigned char *cache_chunk(CacheEntry *e, int seq, int *len, unsigned int *checksum)
+{
+    long long offset = (long long)seq * BUFLEN;
+    if (offset >= e->size) return NULL;
+
+    int seg = seq / CACHE_SEGMENT;
+    if (!__atomic_load_n(&e->ready[seg], __ATOMIC_ACQUIRE) && cache_fill(e, seg) == -1) return NULL;
+
+    *len = (e->size - offset < BUFLEN) ? (int)(e->size - offset) : BUFLEN;
+    *checksum = e->checksums[seq];
+    return e->data + offset;
+}
+
+// Resumo para o log: entradas, memória e taxa de acerto
+static inline void cache_summary(char *buf, size_t size)
+{
+    pthread_mutex_lock(&cache_lock);
+    unsigned long long lookups = cache_hits + cache_misses;
+    snprintf(buf, size, "%d arquivos, %.1f MB em memória de %.1f MB reservados (limite %lld MB), "
+             "%.0f%% de acertos",
+             cache_entries, __atomic_load_n(&cache_resident, __ATOMIC_RELAXED) / 1048576.0,
+             cache_bytes / 1048576.0, cache_limit >> 20,
+             lookups ? 100.0 * cache_hits / lookups : 0.0);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+// Métricas do cache no arquivo da telemetria (ver telemetry_extra em ../telemetry.h)
+static inline void cache_metrics(FILE *f)
+{
+    pthread_mutex_lock(&cache_lock);
+    fprintf(f, "# HELP ftp_cache_hits_total Downloads servidos por uma entrada ja existente do cache\n");
+    fprintf(f, "# TYPE ftp_cache_hits_total counter\n");
+    fprintf(f, "ftp_cache_hits_total %llu\n", cache_hits);
+    fprintf(f, "# HELP ftp_cache_misses_total Downloads que nao encontraram o arquivo no cache\n");
+    fprintf(f, "# TYPE ftp_cache_misses_total counter\n");
+    fprintf(f, "ftp_cache_misses_total %llu\n", cache_misses);
+    fprintf(f, "# HELP ftp_cache_entries Arquivos no cache\n");
+    fprintf(f, "# TYPE ftp_cache_entries gauge\n");
+    fprintf(f, "ftp_cache_entries %d\n", cache_entries);
+    fprintf(f, "# HELP ftp_cache_reserved_bytes Memoria reservada pelas entradas\n");
+    fprintf(f, "# TYPE ftp_cache_reserved_bytes gauge\n");
+    fprintf(f, "ftp_cache_reserved_bytes %lld\n", cache_bytes);
+    fprintf(f, "# HELP ftp_cache_resident_bytes Bytes ja lidos do disco para o cache\n");
+    fprintf(f, "# TYPE ftp_cache_resident_bytes gauge\n");
+    fprintf(f, "ftp_cache_resident_bytes %lld\n", __atomic_load_n(&cache_resident, __ATOMIC_RELAXED));
+    fprintf(f, "# HELP ftp_cache_limit_bytes Limite do cache (--cache)\n");
+    fprintf(f, "# TYPE ftp_cache_limit_bytes gauge\n");
+    fprintf(f, "ftp_cache_limit_bytes %lld\n", cache_limit);
+    pthread_mutex_unlock(&cache_lock);
+}
+
+#endif
@@ -0,0 +1,246 @@
+/*
+    Destino de dados do receptor: escrita direta no offset do arquivo
+    Compartilhado por client.cpp (download) e server.cpp (upload)
+
+    Cada pacote DATA verificado vai direto para o seu lugar no arquivo com
+    pwrite (seq * BUFLEN: o remetente envia blocos cheios, só o último menor),
+    então nada fica retido em memória esperando os buracos anteriores. O que já
+    chegou acima de base é registrado num bitmap de MAX_WINDOW bits (índice =
+    seq % MAX_WINDOW), que também fornece o SACK; a memória por sessão é
+    proporcional à janela, não ao arquivo.
+
+    Com checkpoint habilitado (sink_enable_checkpoint), base, hash do prefixo
+    e bitmap vão periodicamente para o sidecar de retomada (ver ../checkpoint.h).
+    Com ckpt_defer o sink só avisa (ckpt_due) e quem chama grava o retrato
+    (sink_checkpoint) fora do laço de recepção, como faz o reactor do servidor.
+
+    Controle de fluxo: cada ACK anuncia uma janela (rwnd, ver sink_rwnd) e o
+    remetente não envia além de cum_ack + rwnd, mesmo com a cwnd maior. O
+    limite é o menor entre o bitmap (base + MAX_WINDOW) e o espaço livre no
+    buffer de recepção do socket a partir do último pacote escrito: os
+    datagramas ainda não lidos (atraso do escritor, disco lento) ocupam esse
+    espaço, então um receptor lento fecha a janela em vez de perder pacotes
+    que o remetente tomaria por congestionamento.
+*/
+#ifndef FTP_FILE_SINK_H
+#define FTP_FILE_SINK_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#ifdef __linux__
+#include <linux/sock_diag.h>
+#endif
+
+#include "../protocol.h"
+#include "../checksum.h"
+#include "../checkpoint.h"
+#include "../telemetry.h"
+#include "../log.h"
+#include "congestion.h"
+
+static_assert(MAX_WINDOW <= CHECKPOINT_BITS, "checkpoint menor que a janela");
+
+#define RWND_PACKET_COST 2304          // Buffer do socket por datagrama de ~1 KB (truesize no Linux)
+
+typedef struct {
+    int fd;
+    int base;                          // próximo seq ainda não recebido
+    uint64_t bits[MAX_WINDOW / 64];    // recebidos em [base, base + MAX_WINDOW)
+    uint32_t crcs[MAX_WINDOW];         // CRC dos recebidos, para o hash do prefixo
+    uint32_t prefix_hash;              // hash rolante de [0, base) (retomada)
+    long long bytes;                   // bytes escritos no arquivo
+    const char *tag;                   // prefixo das mensagens ("[UPLOAD] ", "")
+    const char *ckpt_path;             // arquivo de dados do checkpoint (NULL: sem)
+    int ckpt_base;                     // base na última gravação do checkpoint
+    int ckpt_defer;                    // 1: sink_on_data só marca ckpt_due (quem chama grava)
+    int ckpt_due;                      // checkpoint vencido esperando quem chama
+    int pending;                       // recebidos fora de ordem acima de base
+    int highest;                       // maior seq já escrito (base - 1: nenhum)
+    TransferStats *stats;              // telemetria do servidor (NULL: sem)
+} FileSink;
+
+static inline int sink_has(const FileSink *sink, int seq)
+{
+    int idx = seq % MAX_WINDOW;
+    return (sink->bits[idx / 64] >> (idx % 64)) & 1;
+}
+
+static inline void sink_set(FileSink *sink, int seq, int value)
+{
+    int idx = seq % MAX_WINDOW;
+    if (value)
+        sink->bits[idx / 64] |= (uint64_t)1 << (idx % 64);
+    else
+        sink->bits[idx / 64] &= ~((uint64_t)1 << (idx % 64));
+}
+
+// base: primeiro pacote esperado (início da faixa; 0 no arquivo todo)
+static inline void sink_init(FileSink *sink, int fd, int base, const char *tag)
+{
+    memset(sink, 0, sizeof(*sink));
+    sink->fd = fd;
+    sink->base = base;
+    sink->highest = base - 1;
+    sink->tag = tag;
+    sink->prefix_hash = resume_hash_init();
+}
+
+// Grava base, hash e bitmap em <data_path>.ckpt durante a recepção
+static inline void sink_enable_checkpoint(FileSink *sink, const char *data_path)
+{
+    sink->ckpt_path = data_path;
+    sink->ckpt_base = sink->base;
+}
+
+// Continua de um checkpoint gravado por uma tentativa anterior
+static inline void sink_restore(FileSink *sink, const Checkpoint *ck)
+{
+    sink->base = ck->base;
+    sink->highest = ck->base - 1;
+    sink->ckpt_base = ck->base;
+    sink->prefix_hash = ck->prefix_hash;
+    memset(sink->bits, 0, sizeof(sink->bits));
+    sink->pending = 0;
+    for (int i = 1; i < MAX_WINDOW; i++) {
+        if ((ck->bits[i / 64] >> (i % 64)) & 1) {
+            sink_set(sink, ck->base + i, 1);
+            sink->pending++;
+            sink->highest = ck->base + i;
+            sink->crcs[(ck->base + i) % MAX_WINDOW] = ck->crcs[i];
+        }
+    }
+}
+
+// Retrato do progresso atual no formato do sidecar
+static inline void sink_checkpoint(const FileSink *sink, Checkpoint *ck)
+{
+    memset(ck, 0, sizeof(*ck));
+    ck->base = sink->base;
+    ck->prefix_hash = sink->prefix_hash;
+    for (int i = 1; i < MAX_WINDOW; i++) {
+        if (sink_has(sink, sink->base + i)) {
+            ck->bits[i / 64] |= (uint64_t)1 << (i % 64);
+            ck->crcs[i] = sink->crcs[(sink->base + i) % MAX_WINDOW];
+        }
+    }
+}
+
+static inline void sink_save_checkpoint(FileSink *sink)
+{
+    if (!sink->ckpt_path) return;
+
+    Checkpoint ck;
+    sink_checkpoint(sink, &ck);
+    if (checkpoint_save(sink->ckpt_path, sink->fd, &ck) == 0) {
+        sink->ckpt_base = sink->base;
+    }
+}
+
+// Fim da recepção: concluída remove o checkpoint; interrompida grava o
+// progresso desta tentativa (se houve) para a próxima retomar dali
+static inline void sink_finish(FileSink *sink, int completed)
+{
+    if (!sink->ckpt_path) return;
+    if (completed) {
+        checkpoint_remove(sink->ckpt_path);
+    } else if (sink->bytes > 0) {
+        sink_save_checkpoint(sink);
+        printf("%s💾 Checkpoint salvo: %d pacotes confirmados\n", sink->tag, sink->base);
+    }
+}
+
+// Trata um pacote DATA: confere o checksum, escreve no offset e avança a base.
+// Retorna 1 se o pacote deve ser confirmado (novo ou duplicata abaixo da base)
+static inline int sink_on_data(FileSink *sink, const Packet *pkt)
+{
+    // Verificar checksum
+    unsigned int calc_checksum = calculate_checksum(pkt->data, pkt->data_len);
+    if (pkt->checksum != calc_checksum) {
+        LOG(LOG_WARN, "%s❌ Checksum inválido seq=%d\n", sink->tag, pkt->seq_num);
+        TELEMETRY_ADD(sink->stats, checksum_failures, 1);
+        return 0;
+    }
+    TELEMETRY_ADD(sink->stats, packets, 1);
+
+    // Além da janela: não há como registrar, o remetente reenvia
+    if (pkt->seq_num >= sink->base + MAX_WINDOW) return 0;
+
+    // Abaixo da base é duplicata já escrita e só precisa do ACK
+    if (pkt->seq_num >= sink->base && !sink_has(sink, pkt->seq_num)) {
+        off_t offset = (off_t)pkt->seq_num * BUFLEN;
+        if (pwrite(sink->fd, pkt->data, pkt->data_len, offset) != pkt->data_len) {
+            perror("pwrite");
+            return 0;
+        }
+        sink->bytes += pkt->data_len;
+        sink->pending++;
+        if (pkt->seq_num > sink->highest) sink->highest = pkt->seq_num;
+        sink_set(sink, pkt->seq_num, 1);
+        sink->crcs[pkt->seq_num % MAX_WINDOW] = pkt->checksum;
+        LOG(LOG_PACKET, "%s📥 Recebido seq=%d ✓ Checksum OK\n", sink->tag, pkt->seq_num);
+
+        // Trecho contíguo a partir da base já está no arquivo
+        while (sink_has(sink, sink->base)) {
+            sink_set(sink, sink->base, 0);
+            sink->prefix_hash = resume_hash_step(sink->prefix_hash,
+                                                 sink->crcs[sink->base % MAX_WINDOW]);
+            sink->base++;
+            sink->pending--;
+        }
+        TELEMETRY_ADD(sink->stats, bytes, pkt->data_len);
+        TELEMETRY_SET(sink->stats, window, sink->pending);
+
+        if (sink->ckpt_path && sink->base - sink->ckpt_base >= CHECKPOINT_INTERVAL) {
+            // Com ckpt_defer o fsync fica para quem chama (reactor: pool de arquivo)
+            if (sink->ckpt_defer)
+                sink->ckpt_due = 1;
+            else
+                sink_save_checkpoint(sink);
+        }
+    } else {
+        TELEMETRY_ADD(sink->stats, retransmits, 1);
+    }
+    return 1;
+}
+
+// Bitmap SACK dos pacotes já recebidos acima de base (base em si está faltando)
+static inline uint64_t sink_sack_bitmap(const FileSink *sink)
+{
+    uint64_t bits = 0;
+    for (int i = 0; i < SACK_BITS && i + 1 < MAX_WINDOW; i++) {
+        if (sink_has(sink, sink->base + 1 + i)) bits |= (uint64_t)1 << i;
+    }
+    return bits;
+}
+
+// Espaço livre no buffer de recepção do socket, em pacotes, depois de ler o
+// que já estava na fila; -1 se o kernel não informa (SO_MEMINFO é do Linux)
+static inline int socket_room(int sockfd)
+{
+#if defined(__linux__) && defined(SO_MEMINFO)
+    uint32_t mem[SK_MEMINFO_VARS];
+    socklen_t len = sizeof(mem);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_MEMINFO, mem, &len) == 0 &&
+        len > SK_MEMINFO_RCVBUF * sizeof(uint32_t)) {
+        long long free_bytes = (long long)mem[SK_MEMINFO_RCVBUF] - mem[SK_MEMINFO_RMEM_ALLOC];
+        return free_bytes > 0 ? (int)(free_bytes / RWND_PACKET_COST) : 0;
+    }
+#else
+    (void)sockfd;
+#endif
+    return -1;
+}
+
+// Janela anunciada no ACK (pacotes a partir de base): o que cabe no bitmap e,
+// com room >= 0, no socket além do último pacote escrito. Nunca menos que 1
+static inline int sink_rwnd(const FileSink *sink, int room)
+{
+    int edge = sink->base + MAX_WINDOW;
+    if (room >= 0 && sink->highest + 1 + room < edge) edge = sink->highest + 1 + room;
+    return edge - sink->base > 1 ? edge - sink->base : 1;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+    Fonte de dados do remetente: arquivo mapeado em memória
+    Compartilhado por client.cpp e server.cpp
+
+    O anel de envio guarda, por pacote, só o tamanho, o checksum e um ponteiro
+    para o payload dentro do mapeamento. batch_add_data() (../batch_io.h) monta
+    cada datagrama com dois iovecs, cabeçalho + payload, então o conteúdo do
+    arquivo não é copiado em espaço de usuário e a retransmissão só volta a
+    referenciar o mesmo trecho do mapeamento.
+
+    Se o mmap não for possível (arquivo vazio, pipe, sistema de arquivos sem
+    suporte), os blocos são lidos com read() para um buffer do tamanho do anel.
+    Um arquivo truncado por outro processo durante o envio gera SIGBUS ao
+    acessar o mapeamento, como em qualquer leitor baseado em mmap.
+*/
+#ifndef FTP_FILE_SOURCE_H
+#define FTP_FILE_SOURCE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../protocol.h"
+
+// Pacote DATA no anel de envio (índice = seq % RING_SIZE)
+typedef struct {
+    int data_len;
+    unsigned int checksum;
+    const unsigned char *payload;       // no mapeamento (ou no buffer de leitura)
+} RingSlot;
+
+typedef struct {
+    int fd;
+    long long size;                     // tamanho no momento da abertura
+    const unsigned char *map;           // NULL: blocos lidos com read()
+    unsigned char *buffer;              // slots x BUFLEN, só sem mapeamento
+    int slots;
+} FileSource;
+
+// Mapeia o arquivo aberto em fd; slots é o tamanho do anel (usado só sem mmap)
+static int source_open(FileSource *src, int fd, int slots)
+{
+    memset(src, 0, sizeof(*src));
+    src->fd = fd;
+    src->slots = slots;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) return -1;
+    src->size = st.st_size;
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+            src->map = (const unsigned char*)map;
+            return 0;
+        }
+    }
+
+    src->buffer = (unsigned char*)malloc((size_t)slots * BUFLEN);
+    return src->buffer ? 0 : -1;
+}
+
+// Payload do bloco seq (BUFLEN bytes a partir de seq * BUFLEN); NULL no fim
+// do arquivo. Sem mapeamento os blocos precisam ser pedidos em ordem
+static const unsigned char *source_chunk(FileSource *src, int seq, int *len)
+{
+    if (src->map) {
+        long long offset = (long long)seq * BUFLEN;
+        if (offset >= src->size) return NULL;
+        *len = (src->size - offset < BUFLEN) ? (int)(src->size - offset) : BUFLEN;
+        return src->map + offset;
+    }
+
+    // Pipe ou FIFO entregam leituras curtas: só um bloco cheio (ou o fim do
+    // arquivo) vira pacote, senão o receptor gravaria no offset errado
+    unsigned char *buf = src->buffer + (size_t)(seq % src->slots) * BUFLEN;
+    int bytes_read = 0;
+    while (bytes_read < BUFLEN) {
+        ssize_t n = read(src->fd, buf + bytes_read, BUFLEN - bytes_read);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) break;
+        bytes_read += (int)n;
+    }
+    if (bytes_read == 0) return NULL;
+    *len = bytes_read;
+    return buf;
+}
+
+static void source_close(FileSource *src)
+{
+    if (src->map) munmap((void*)src->map, (size_t)src->size);
+    free(src->buffer);
+    src->map = NULL;
+    src->buffer = NULL;
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+    Recuperação rápida de perdas do remetente Selective Repeat
+    Compartilhado por server.cpp (download) e client.cpp (upload)
+
+    O RTO (ver ../rtt.h) passa a ser o último recurso. Antes dele:
+    - RACK (RFC 8985): um pacote está perdido quando algum pacote enviado
+      depois dele já foi entregue (ACK cumulativo ou SACK) e já se passou o
+      RTT dessa entrega mais uma janela de reordenação (SRTT/4, mínimo 100 µs).
+      A ordem é a do instante da última transmissão, então uma retransmissão
+      perdida também é detectada sem esperar o timeout.
+    - Tail loss probe: sem ACK por PTO = max(2·SRTT, 10 ms), reenvia o último
+      pacote em voo. O ACK com SACK que ele provoca dá ao RACK o que falta
+      para detectar perdas nos últimos pacotes do arquivo.
+
+    A retransmissão rápida reduz a cwnd como perda sem timeout (uma vez por
+    janela, ver cc_on_loss em congestion.h); o probe não reduz.
+    Instantes e RTTs em ns (now_ns() de ../rtt.h).
+*/
+#ifndef LOSS_RECOVERY_H
+#define LOSS_RECOVERY_H
+
+#include <string.h>
+
+#define RACK_MIN_REO_NS 100000LL     // Janela de reordenação mínima (100 µs)
+#define TLP_MIN_NS 10000000LL        // PTO mínimo (10 ms)
+
+typedef struct {
+    long long xmit_ns;      // Envio do pacote entregue que foi transmitido por último
+    int seq;                // Seq desse pacote (desempate no mesmo instante)
+    long long rtt_ns;       // RTT dessa entrega
+    long long last_ack_ns;  // Último ACK que entregou pacotes novos
+    int probe_seq;          // Probe em voo (-1: nenhum)
+} LossRecovery;
+
+static void lr_init(LossRecovery *lr)
+{
+    memset(lr, 0, sizeof(*lr));
+    lr->xmit_ns = -1;
+    lr->seq = -1;
+    lr->probe_seq = -1;
+}
+
+// Pacote seq, transmitido pela última vez em xmit_ns, entregue agora
+static void lr_on_delivered(LossRecovery *lr, int seq, long long xmit_ns, long long now)
+{
+    if (xmit_ns > lr->xmit_ns || (xmit_ns == lr->xmit_ns && seq > lr->seq)) {
+        lr->xmit_ns = xmit_ns;
+        lr->seq = seq;
+        lr->rtt_ns = now - xmit_ns;
+    }
+    lr->last_ack_ns = now;
+    lr->probe_seq = -1;
+}
+
+// Instante em que o pacote (seq, xmit_ns) ainda sem ACK passa a ser dado
+// como perdido; -1 enquanto nenhum pacote transmitido depois dele foi entregue
+static long long lr_rack_deadline(const LossRecovery *lr, int seq, long long xmit_ns, long long srtt_ns)
+{
+    if (xmit_ns > lr->xmit_ns || (xmit_ns == lr->xmit_ns && seq >= lr->seq)) return -1;
+
+    long long reo_wnd = srtt_ns / 4;
+    if (reo_wnd < RACK_MIN_REO_NS) reo_wnd = RACK_MIN_REO_NS;
+    return xmit_ns + lr->rtt_ns + reo_wnd;
+}
+
+// Instante do tail loss probe, contado do último envio ou ACK
+static long long lr_probe_deadline(const LossRecovery *lr, long long last_send_ns, long long srtt_ns)
+{
+    long long pto = 2 * srtt_ns;
+    if (pto < TLP_MIN_NS) pto = TLP_MIN_NS;
+    long long from = last_send_ns > lr->last_ack_ns ? last_send_ns : lr->last_ack_ns;
+    return from + pto;
+}
+
+#endif
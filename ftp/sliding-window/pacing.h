@@ -0,0 +1,119 @@
+/*
+    Pacing do remetente Selective Repeat
+    Compartilhado por server.cpp (download) e client.cpp (upload)
+
+    Sem pacing o laço de envio despeja a cwnd inteira de uma vez: a rajada
+    estoura o buffer do switch e a fila do socket do receptor e provoca as
+    perdas que depois precisam ser retransmitidas. O Pacer é um balde de
+    fichas em bytes que espalha os envios à taxa
+
+        taxa = ganho · cwnd · BUFLEN / SRTT
+
+    com ganho 2 no slow start (a janela dobra a cada RTT) e 1,2 depois, como
+    o pacing do TCP no Linux. O balde acumula no máximo PACING_BURST_NS de
+    taxa (mínimo PACING_MIN_BURST pacotes), o bastante para o reactor, cujos
+    prazos têm resolução de 1 ms, manter a taxa. Sem amostra de RTT não há
+    pacing, só o limite do operador.
+
+    --rate <Mbit/s> limita cada sessão (pacing_max_rate). Onde a sessão tem
+    socket próprio o limite também vai para o kernel com SO_MAX_PACING_RATE,
+    que a qdisc fq aplica por socket; no reactor o socket é compartilhado
+    pelas sessões e o limite fica só no balde.
+
+    Retransmissões não esperam fichas, mas as consomem (o saldo pode ficar
+    negativo e atrasa os pacotes novos).
+*/
+#ifndef FTP_PACING_H
+#define FTP_PACING_H
+
+#include <string.h>
+#include <sys/socket.h>
+
+#include "../protocol.h"
+#include "../rtt.h"
+#include "congestion.h"
+
+#define PACING_GAIN_SS 2.0          // Ganho no slow start
+#define PACING_GAIN_CA 1.2          // Ganho em congestion avoidance
+#define PACING_BURST_NS 2000000LL   // Fichas acumuladas no máximo (2 ms de taxa)
+#define PACING_MIN_BURST 4          // ... e nunca menos que 4 pacotes
+
+// Limite por sessão em bytes/s (--rate); 0: sem limite
+static double pacing_max_rate = 0;
+
+typedef struct {
+    double rate;            // Bytes/s atuais (0: sem pacing)
+    double tokens;          // Bytes que podem sair agora (negativo: em dívida)
+    double burst;           // Teto de tokens
+    long long last_ns;      // Última reposição
+} Pacer;
+
+static void pacer_init(Pacer *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->burst = PACING_MIN_BURST * BUFLEN;
+    p->tokens = p->burst;
+    p->last_ns = now_ns();
+}
+
+// Recalcula a taxa a partir da cwnd e do SRTT atuais
+static void pacer_set_rate(Pacer *p, const CongestionControl *cc, const RttEstimator *rtt)
+{
+    double rate = 0;
+    if (rtt->samples > 0) {
+        double gain = cc->cwnd < cc->ssthresh ? PACING_GAIN_SS : PACING_GAIN_CA;
+        rate = gain * cc->cwnd * BUFLEN / rtt_srtt_s(rtt);
+    }
+    if (pacing_max_rate > 0 && (rate == 0 || rate > pacing_max_rate)) rate = pacing_max_rate;
+
+    p->rate = rate;
+    p->burst = rate * PACING_BURST_NS / 1e9;
+    if (p->burst < PACING_MIN_BURST * BUFLEN) p->burst = PACING_MIN_BURST * BUFLEN;
+}
+
+static void pacer_refill(Pacer *p, long long now)
+{
+    if (p->rate > 0) {
+        p->tokens += p->rate * (now - p->last_ns) / 1e9;
+        if (p->tokens > p->burst) p->tokens = p->burst;
+    } else {
+        p->tokens = p->burst;
+    }
+    p->last_ns = now;
+}
+
+// Pacote novo de bytes bytes: 1 se pode sair agora (e consome as fichas)
+static int pacer_take(Pacer *p, int bytes, long long now)
+{
+    pacer_refill(p, now);
+    if (p->tokens < 0) return 0;
+    p->tokens -= bytes;
+    return 1;
+}
+
+// Retransmissão: sai sem esperar, mas entra na conta
+static void pacer_charge(Pacer *p, int bytes)
+{
+    if (p->rate > 0) p->tokens -= bytes;
+}
+
+// Instante (now_ns()) em que o saldo volta a permitir um envio
+static long long pacer_next_ns(const Pacer *p, long long now)
+{
+    if (p->tokens >= 0 || p->rate <= 0) return now;
+    return now + (long long)(-p->tokens * 1e9 / p->rate) + 1;
+}
+
+// Limite do operador também no kernel, para um socket de uma única sessão
+static void pacing_limit_socket(int sockfd)
+{
+#ifdef SO_MAX_PACING_RATE
+    if (pacing_max_rate <= 0) return;
+    unsigned int rate = pacing_max_rate > 4294967295.0 ? ~0U : (unsigned int)pacing_max_rate;
+    setsockopt(sockfd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate));
+#else
+    (void)sockfd;
+#endif
+}
+
+#endif
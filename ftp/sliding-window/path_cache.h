@@ -0,0 +1,87 @@
+/*
+    Métricas do caminho entre transferências
+    Compartilhado por server.cpp (downloads, por cliente) e client.cpp (uploads, por servidor)
+
+    Cada transferência começava do zero: RTO inicial de 1 s até a primeira
+    amostra, slow start a partir de INITIAL_CWND e sem pacing. Num lote de
+    arquivos pequenos (mget/mput) a transferência inteira cabe nessa fase.
+    Como as métricas TCP do Linux (tcp_metrics), o remetente guarda ao fim de
+    cada transferência SRTT/RTTVAR, cwnd e ssthresh por IP do outro lado, e a
+    próxima transferência para o mesmo IP começa deles. O pacing (pacing.h)
+    espalha a primeira janela herdada, então ela não sai como rajada.
+
+    Entradas mais velhas que PATH_CACHE_TTL_NS são ignoradas; com a tabela
+    cheia a mais antiga é substituída.
+*/
+#ifndef FTP_PATH_CACHE_H
+#define FTP_PATH_CACHE_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+
+#include "../rtt.h"
+#include "congestion.h"
+
+#define PATH_CACHE_SLOTS 64
+#define PATH_CACHE_TTL_NS 300000000000LL    // 5 min
+
+typedef struct {
+    uint32_t addr;          // IPv4 do outro lado (0: livre)
+    long long stamp_ns;     // Fim da transferência que gravou (now_ns())
+    RttEstimator rtt;
+    double cwnd;
+    double ssthresh;
+} PathMetrics;
+
+static PathMetrics path_cache[PATH_CACHE_SLOTS];
+static pthread_mutex_t path_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Semeia o estimador e a cwnd de uma transferência nova para peer; 1 se havia métricas
+static int path_cache_load(const struct sockaddr_in *peer, RttEstimator *rtt, CongestionControl *cc)
+{
+    int found = 0;
+    long long now = now_ns();
+    pthread_mutex_lock(&path_cache_lock);
+    for (int i = 0; i < PATH_CACHE_SLOTS && !found; i++) {
+        const PathMetrics *m = &path_cache[i];
+        if (m->addr != peer->sin_addr.s_addr || now - m->stamp_ns > PATH_CACHE_TTL_NS) continue;
+
+        long long min_rto = rtt->min_rto_ns;
+        *rtt = m->rtt;
+        rtt->min_rto_ns = min_rto;
+        rtt->backoff = 0;
+        cc->cwnd = m->cwnd > INITIAL_CWND ? m->cwnd : INITIAL_CWND;
+        if (cc->cwnd > cc->max_window) cc->cwnd = cc->max_window;
+        cc->ssthresh = m->ssthresh;
+        found = 1;
+    }
+    pthread_mutex_unlock(&path_cache_lock);
+    return found;
+}
+
+// Fim de uma transferência para peer: guarda as métricas (só com amostra de RTT)
+static void path_cache_store(const struct sockaddr_in *peer, const RttEstimator *rtt,
+                             const CongestionControl *cc)
+{
+    if (rtt->samples == 0 || peer->sin_addr.s_addr == 0) return;
+
+    pthread_mutex_lock(&path_cache_lock);
+    PathMetrics *slot = &path_cache[0];
+    for (int i = 0; i < PATH_CACHE_SLOTS; i++) {
+        PathMetrics *m = &path_cache[i];
+        if (m->addr == peer->sin_addr.s_addr) {
+            slot = m;
+            break;
+        }
+        if (m->stamp_ns < slot->stamp_ns) slot = m;
+    }
+    slot->addr = peer->sin_addr.s_addr;
+    slot->stamp_ns = now_ns();
+    slot->rtt = *rtt;
+    slot->cwnd = cc->cwnd;
+    slot->ssthresh = cc->ssthresh;
+    pthread_mutex_unlock(&path_cache_lock);
+}
+
+#endif
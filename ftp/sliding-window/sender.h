@@ -0,0 +1,591 @@
+/*
+    Remetente Selective Repeat: janela de envio, ACKs e retransmissões
+    Compartilhado por server.cpp (download) e client.cpp (upload)
+
+    O anel tem RING_SIZE posições: [base, next_seq_num) estão em voo e
+    [next_seq_num, read_seq) já foram lidos do arquivo e aguardam espaço na
+    janela. Os dois lados usam a mesma estrutura; cada um preenche só os
+    campos do seu papel (cache e telemetria no servidor).
+
+    As perdas seguem loss_recovery.h: RACK e probe de cauda antes do RTO,
+    que fica como último recurso (ver sender_check_timeouts).
+*/
+#ifndef FTP_SENDER_H
+#define FTP_SENDER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "../protocol.h"
+#include "../checksum.h"
+#include "../batch_io.h"
+#include "../log.h"
+#include "../rtt.h"
+#include "../telemetry.h"
+#include "congestion.h"
+#include "loss_recovery.h"
+#include "pacing.h"
+#include "path_cache.h"
+#include "file_source.h"
+#include "file_cache.h"
+#include "fec.h"
+
+#define WINDOW_RTO_MIN_NS 200000000LL  // RTO mínimo (200 ms): o RACK e o probe agem antes
+#define RING_SIZE (2 * MAX_WINDOW)  // Anel de envio: janela máxima + leitura antecipada
+#define END_MAX_TRIES 6             // ENDs (um por RTO, com backoff) sem resposta antes de desistir
+#define END_TIMEOUT_NS 10000000000LL // ... ou 10 s: o receptor abandona a sessão ociosa
+
+typedef struct {
+    RingSlot slots[RING_SIZE];          // Anel de pacotes (índice = seq % RING_SIZE)
+    long long send_times[RING_SIZE];    // Instante do último envio (now_ns())
+    unsigned char retransmitted[RING_SIZE]; // Karn: ACK ambíguo, sem amostra de RTT
+    int acked[RING_SIZE];               // ACKs recebidos
+    unsigned char parity[RING_SIZE];    // Paridades do bloco FEC que termina em seq
+    int parity_inflight;                // Paridades de blocos acima de base (ocupam a cwnd)
+    int base;                           // Início da janela
+    int next_seq_num;                   // Próximo a enviar
+    int read_seq;                       // Próximo a ler do arquivo
+    int total_packets;                  // Fim da faixa (exclusivo; arquivo todo: total)
+    pthread_mutex_t lock;               // Mutex para sincronização
+    pthread_cond_t ack_cond;            // Sinalizado quando ACKs abrem espaço na janela (relógio now_ns())
+    pthread_cond_t timer_cond;          // Acorda a thread de timeouts (novos envios/fim)
+    int sockfd;
+    struct sockaddr_in peer_addr;       // Receptor (cliente no download, servidor no upload)
+    socklen_t addr_len;
+    int finished;                       // Flag para encerrar threads
+    int end_status;                     // Resposta ao END: 1 confirmado, -1 recusado (ERROR)
+    int rwnd_edge;                      // Limite anunciado pelo receptor (cum_ack + rwnd)
+    int rwnd_cum;                       // cum_ack do ACK que definiu rwnd_edge (SND.WL1)
+    RttEstimator rtt;                   // SRTT/RTTVAR/RTO com backoff
+    CongestionControl cc;               // Janela de congestionamento (cwnd)
+    LossRecovery lr;                    // Detecção rápida de perdas (RACK/TLP)
+    Pacer pacer;                        // Ritmo dos envios (cwnd/SRTT, --rate)
+    uint32_t session_id;                // Sessão repetida em todos os pacotes
+    FileSource source;                  // Arquivo mapeado (payload dos slots) sem cache
+    CacheEntry *cache;                  // Entrada do cache do servidor, ou NULL
+    int cache_hit;                      // A entrada já existia
+    FecEncoder *fec;                    // Paridade dos blocos (--fec), ou NULL
+    PacketBatch tx;                     // Rajada de envio (montada com o lock)
+    TransferStats *stats;               // Telemetria da sessão (NULL sem --stats)
+    pthread_t ack_thread;               // sender_start/sender_stop
+    pthread_t timer_thread;
+} SlidingWindow;
+
+// Marca seq como entregue (alimenta o RACK); retorna 1 se era novo
+static int mark_acked(SlidingWindow *window, int seq, long long now)
+{
+    int idx = seq % RING_SIZE;
+    if (window->acked[idx]) return 0;
+    window->acked[idx] = 1;
+    lr_on_delivered(&window->lr, seq, window->send_times[idx], now);
+    return 1;
+}
+
+// Marca como confirmados os pacotes cobertos pelo ACK: todos abaixo de
+// cum_ack e os indicados no bitmap SACK. Retorna quantos eram novos.
+static int apply_sack(SlidingWindow *window, const Packet *ack, long long now)
+{
+    int newly_acked = 0;
+    int end = window->next_seq_num;
+
+    for (int seq = window->base; seq < ack->cum_ack && seq < end; seq++) {
+        newly_acked += mark_acked(window, seq, now);
+    }
+
+    for (int i = 0; i < SACK_BITS; i++) {
+        if (!((ack->sack_bits >> i) & 1)) continue;
+        int seq = ack->cum_ack + 1 + i;
+        if (seq < window->base || seq >= end) continue;
+        newly_acked += mark_acked(window, seq, now);
+    }
+
+    // O próprio seq confirmado (cobre ACKs além do alcance do bitmap)
+    int seq = ack->seq_num;
+    if (seq >= window->base && seq < end) {
+        newly_acked += mark_acked(window, seq, now);
+    }
+    return newly_acked;
+}
+
+// Janela anunciada no ACK (0: não anunciada). Como o SND.WL1 do TCP, só um
+// ACK com cum_ack pelo menos igual ao do último anúncio a atualiza: um ACK
+// antigo que chega atrasado não fecha de novo o espaço já anunciado
+static void sender_on_rwnd(SlidingWindow *window, const Packet *ack)
+{
+    if (ack->rwnd <= 0 || ack->cum_ack < window->rwnd_cum) return;
+    window->rwnd_cum = ack->cum_ack;
+    window->rwnd_edge = ack->cum_ack + ack->rwnd;
+}
+
+// Fim (exclusivo) do que pode estar em voo: o menor entre a cwnd, descontadas
+// as paridades FEC ainda em voo, e a janela anunciada pelo receptor. Com a
+// janela anunciada fechada ainda sai um pacote de sonda, cujo ACK traz o
+// espaço liberado
+static int sender_window_edge(const SlidingWindow *window)
+{
+    int edge = window->base + cc_window(&window->cc) - window->parity_inflight;
+    if (edge < window->base) edge = window->base;
+    int rwnd_edge = window->rwnd_edge > window->base ? window->rwnd_edge : window->base + 1;
+    return edge < rwnd_edge ? edge : rwnd_edge;
+}
+
+// Há pacotes lidos que cabem na cwnd e na janela anunciada
+static int sender_can_send(const SlidingWindow *window)
+{
+    return window->next_seq_num < sender_window_edge(window) &&
+           window->next_seq_num < window->read_seq;
+}
+
+// Processa um ACK (cumulativo + SACK): amostra de RTT, cwnd e deslizamento
+// da base. Chamado com o lock da janela; retorna quantos pacotes eram novos
+static int sender_on_ack(SlidingWindow *window, const Packet *ack)
+{
+    long long now = now_ns();
+    int seq = ack->seq_num;
+    int idx = seq % RING_SIZE;
+    double sample_rtt = rtt_srtt_s(&window->rtt);
+
+    // Amostra de RTT só do pacote que gerou este ACK, se nunca foi
+    // retransmitido (regra de Karn)
+    if (seq >= window->base && seq < window->next_seq_num &&
+        !window->acked[idx] && !window->retransmitted[idx]) {
+        rtt_sample(&window->rtt, now - window->send_times[idx]);
+        sample_rtt = (now - window->send_times[idx]) / 1e9;
+        telemetry_rtt(window->stats, rtt_srtt_s(&window->rtt), rtt_rttvar_s(&window->rtt));
+    }
+
+    sender_on_rwnd(window, ack);
+
+    // Um ACK pode confirmar vários pacotes (cumulativo + SACK)
+    int newly_acked = apply_sack(window, ack, now);
+    if (window->fec) fec_on_ack(window->fec, ack->fec_recovered);
+    for (int i = 0; i < newly_acked; i++) {
+        cc_on_ack(&window->cc, sample_rtt, now / 1e9);
+    }
+
+    if (newly_acked > 0) {
+        LOG(LOG_PACKET, "  ✓ ACK recebido seq=%d cum=%d (+%d, RTT=%.6fs, cwnd=%.1f)\n",
+            seq, ack->cum_ack, newly_acked, sample_rtt, window->cc.cwnd);
+    }
+
+    // Deslizar janela se o base foi confirmado
+    long long delivered = 0;
+    while (window->acked[window->base % RING_SIZE] &&
+           window->base < window->total_packets) {
+        window->acked[window->base % RING_SIZE] = 0;
+        delivered += window->slots[window->base % RING_SIZE].data_len;
+        // Bloco FEC confirmado: as paridades dele deixam de ocupar a cwnd
+        window->parity_inflight -= window->parity[window->base % RING_SIZE];
+        window->parity[window->base % RING_SIZE] = 0;
+        window->base++;
+    }
+    TELEMETRY_ADD(window->stats, bytes, delivered);
+    TELEMETRY_SET(window->stats, window, window->next_seq_num - window->base);
+    TELEMETRY_SET(window->stats, cwnd, window->cc.cwnd);
+    return newly_acked;
+}
+
+// Reenfileira seq na rajada de envio: o payload continua no mapeamento,
+// só o cabeçalho é codificado de novo
+static void sender_retransmit(SlidingWindow *window, int seq, long long now)
+{
+    int idx = seq % RING_SIZE;
+    RingSlot *slot = &window->slots[idx];
+    batch_add_data(window->sockfd, &window->tx, window->session_id, seq, slot->checksum,
+                   slot->payload, slot->data_len, &window->peer_addr, window->addr_len);
+
+    window->send_times[idx] = now;
+    window->retransmitted[idx] = 1;
+    pacer_charge(&window->pacer, slot->data_len);
+    TELEMETRY_ADD(window->stats, packets, 1);
+    TELEMETRY_ADD(window->stats, retransmits, 1);
+}
+
+// Retransmite os pacotes perdidos: pelo RACK logo que um pacote enviado
+// depois foi entregue, pelo RTO em último caso, e o probe de cauda quando
+// os ACKs param. Chamado com o lock da janela (também logo após os ACKs);
+// instantes em ns, retorna o próximo prazo (now + 5 s se não há pacotes em voo)
+static long long sender_check_timeouts(SlidingWindow *window, long long now)
+{
+    long long rto = rtt_rto_ns(&window->rtt);
+    long long srtt = rtt_srtt_ns(&window->rtt);
+    long long next_deadline = now + 5000000000LL;
+    long long last_send = -1;
+    int last_unacked = -1;
+    int timed_out = 0;
+
+    // Verifica o prazo de cada pacote na janela
+    for (int seq = window->base; seq < window->next_seq_num; seq++) {
+        int idx = seq % RING_SIZE;
+        if (window->acked[idx]) continue;
+
+        int timeout = (now - window->send_times[idx]) > rto;
+        long long xmit = window->fec ? fec_rack_time(window->fec, seq, window->send_times[idx])
+                                     : window->send_times[idx];
+        long long rack = lr_rack_deadline(&window->lr, seq, xmit, srtt);
+
+        if (timeout || (rack >= 0 && now >= rack)) {
+            // RETRANSMITIR apenas este pacote (Selective Repeat)
+            sender_retransmit(window, seq, now);
+            // Uma redução por rodada de RTO, como o backoff (não uma por pacote vencido)
+            if (!timeout || !timed_out) {
+                cc_on_loss(&window->cc, seq, window->next_seq_num, timeout, now / 1e9);
+            }
+            if (window->fec) fec_on_loss(window->fec);
+            TELEMETRY_SET(window->stats, cwnd, window->cc.cwnd);
+
+            if (timeout) {
+                timed_out = 1;
+                LOG(LOG_WARN, "  🔄 Retransmitindo seq=%d (timeout=%.1fms, cwnd=%.1f)\n", 
+                    seq, rto / 1e6, window->cc.cwnd);
+            } else {
+                LOG(LOG_WARN, "  ⚡ Retransmissão rápida seq=%d (RACK, cwnd=%.1f)\n", 
+                    seq, window->cc.cwnd);
+            }
+        } else if (rack >= 0 && rack < next_deadline) {
+            next_deadline = rack;
+        }
+
+        long long deadline = window->send_times[idx] + rto + 1;
+        if (deadline < next_deadline) next_deadline = deadline;
+        if (window->send_times[idx] > last_send) last_send = window->send_times[idx];
+        last_unacked = seq;
+    }
+
+    // Backoff exponencial: uma dobra do RTO por rodada de timeouts
+    if (timed_out) rtt_on_timeout(&window->rtt);
+
+    // Probe de cauda: reenvia o último pacote em voo se os ACKs pararam
+    if (last_unacked >= 0 && window->lr.probe_seq < 0) {
+        long long probe = lr_probe_deadline(&window->lr, last_send, srtt);
+        if (now >= probe) {
+            sender_retransmit(window, last_unacked, now);
+            window->lr.probe_seq = last_unacked;
+            LOG(LOG_WARN, "  🔍 Probe de cauda seq=%d\n", last_unacked);
+        } else if (probe < next_deadline) {
+            next_deadline = probe;
+        }
+    }
+    batch_flush(window->sockfd, &window->tx);
+    return next_deadline;
+}
+
+// Thread de timeouts: retransmite pelo RACK/probe/RTO e dorme até o prazo
+// mais próximo (ou até um novo envio, sinalizado em timer_cond)
+static void *sender_timer_thread(void *arg)
+{
+    SlidingWindow *window = (SlidingWindow*)arg;
+
+    pthread_mutex_lock(&window->lock);
+    while (!window->finished) {
+        long long next_deadline = sender_check_timeouts(window, now_ns());
+
+        struct timespec ts;
+        ns_to_timespec(next_deadline, &ts);
+        pthread_cond_timedwait(&window->timer_cond, &window->lock, &ts);
+    }
+    pthread_mutex_unlock(&window->lock);
+    return NULL;
+}
+
+// Thread que recebe os ACKs da janela (socket próprio da transferência).
+// Datagramas de outro endereço ou sessão (ex.: END repetido de uma
+// transferência anterior) são ignorados; um ERROR do receptor recusa o END
+static void *sender_ack_thread(void *arg)
+{
+    SlidingWindow *window = (SlidingWindow*)arg;
+    Packet ack;
+
+    PacketBatch *rx = (PacketBatch*)calloc(1, sizeof(PacketBatch));
+    if (!rx) {
+        perror("malloc sender_ack_thread");
+        return NULL;
+    }
+
+    struct timeval tv;
+    tv.tv_sec = 0;
+    tv.tv_usec = 100000; // 100ms: confere finished
+    setsockopt(window->sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (!window->finished) {
+        // Todos os ACKs já na fila são processados com um único lock
+        int count = batch_recv(window->sockfd, rx);
+        if (count <= 0) continue;
+
+        pthread_mutex_lock(&window->lock);
+        int newly_acked = 0;
+        int rwnd_edge = window->rwnd_edge;
+        for (int i = 0; i < count; i++) {
+            if (!same_addr(&rx->addrs[i], &window->peer_addr) ||
+                batch_packet(rx, i, &ack) == -1 || ack.session_id != window->session_id) {
+                continue;
+            }
+            if (ack.type == PKT_ERROR) {
+                printf("  ❌ Erro do receptor: %s\n", ack.data);
+                window->end_status = -1;
+                pthread_cond_broadcast(&window->ack_cond);
+                continue;
+            }
+            if (ack.type != PKT_ACK) continue;
+            newly_acked += sender_on_ack(window, &ack);
+
+            // ACK do END: além do último pacote, com a janela já drenada
+            if (ack.seq_num >= window->total_packets && window->base >= window->total_packets) {
+                window->end_status = 1;
+                pthread_cond_broadcast(&window->ack_cond);
+            }
+        }
+
+        // Acorda o laço de envio: a base andou ou a cwnd cresceu. As entregas
+        // novas podem revelar perdas (RACK): retransmite já e a thread de
+        // timeouts recalcula o prazo
+        if (newly_acked > 0) {
+            sender_check_timeouts(window, now_ns());
+            pthread_cond_broadcast(&window->ack_cond);
+            pthread_cond_signal(&window->timer_cond);
+        } else if (window->rwnd_edge > rwnd_edge) {
+            pthread_cond_broadcast(&window->ack_cond);   // O receptor abriu a janela anunciada
+        }
+
+        pthread_mutex_unlock(&window->lock);
+    }
+    free(rx);
+    return NULL;
+}
+
+// Janela recém-alocada (calloc) para os pacotes [first, end), com a fonte
+// (source ou cache) já aberta. RTT e cwnd partem das métricas do caminho
+static void sender_init(SlidingWindow *window, int sockfd, const struct sockaddr_in *addr,
+                        socklen_t addr_len, uint32_t session_id, int first, int end,
+                        const CongestionOps *ops)
+{
+    window->base = first;
+    window->next_seq_num = first;
+    window->read_seq = first;
+    window->total_packets = end;
+    window->sockfd = sockfd;
+    window->peer_addr = *addr;
+    window->addr_len = addr_len;
+    window->finished = 0;
+    window->rwnd_edge = INT_MAX;
+    window->session_id = session_id;
+    rtt_init(&window->rtt, WINDOW_RTO_MIN_NS);
+    cc_init(&window->cc, ops, MAX_WINDOW);
+    path_cache_load(addr, &window->rtt, &window->cc);
+    lr_init(&window->lr);
+    pacer_init(&window->pacer);
+    if (fec_enabled) window->fec = fec_encoder_new();
+    pthread_mutex_init(&window->lock, NULL);
+
+    // Prazos da thread de timeouts, do pacer e do END em now_ns()
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&window->ack_cond, &attr);
+    pthread_cond_init(&window->timer_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (io_offload) batch_enable_gso(sockfd, &window->tx);
+}
+
+// Fim da janela: as métricas do caminho ficam para a próxima transferência
+// com o mesmo IP
+static void sender_destroy(SlidingWindow *window)
+{
+    path_cache_store(&window->peer_addr, &window->rtt, &window->cc);
+    pthread_mutex_destroy(&window->lock);
+    pthread_cond_destroy(&window->ack_cond);
+    pthread_cond_destroy(&window->timer_cond);
+    batch_free(&window->tx);
+    source_close(&window->source);
+    if (window->cache) cache_release(window->cache);
+    free(window->fec);
+    free(window);
+}
+
+// Threads de ACKs e de timeouts de uma transferência com threads
+static void sender_start(SlidingWindow *window)
+{
+    pthread_create(&window->ack_thread, NULL, sender_ack_thread, window);
+    pthread_create(&window->timer_thread, NULL, sender_timer_thread, window);
+}
+
+static void sender_stop(SlidingWindow *window)
+{
+    pthread_mutex_lock(&window->lock);
+    window->finished = 1;
+    pthread_cond_signal(&window->timer_cond);
+    pthread_mutex_unlock(&window->lock);
+    pthread_join(window->ack_thread, NULL);
+    pthread_join(window->timer_thread, NULL);
+}
+
+// Lê os pacotes [read_seq, limit) para o anel. Só toca posições à frente de
+// next_seq_num, que as outras threads não acessam, então o acesso ao arquivo
+// (falta de página no mapeamento ou read()) e o checksum acontecem fora do lock.
+static void ring_read(SlidingWindow *window, int limit)
+{
+    while (window->read_seq < limit && window->read_seq < window->total_packets) {
+        RingSlot *slot = &window->slots[window->read_seq % RING_SIZE];
+        int bytes_read;
+        unsigned int checksum = 0;
+        const unsigned char *payload;
+        if (window->cache) {
+            // Checksum já calculado pela sessão que preencheu o segmento
+            payload = cache_chunk(window->cache, window->read_seq, &bytes_read, &checksum);
+        } else {
+            payload = source_chunk(&window->source, window->read_seq, &bytes_read);
+            if (payload) checksum = calculate_checksum((const char*)payload, bytes_read);
+        }
+        if (!payload) {
+            // Arquivo encolheu (ou, no cache, foi reescrito) durante a
+            // transferência: encerra no que foi lido
+            pthread_mutex_lock(&window->lock);
+            window->total_packets = window->read_seq;
+            pthread_mutex_unlock(&window->lock);
+            break;
+        }
+        slot->payload = payload;
+        slot->data_len = bytes_read;
+        slot->checksum = checksum;
+        window->read_seq++;
+    }
+}
+
+// Leitura antecipada: completa o anel com os próximos pacotes do arquivo
+static void fill_ring(SlidingWindow *window)
+{
+    pthread_mutex_lock(&window->lock);
+    int limit = window->base + RING_SIZE;
+    pthread_mutex_unlock(&window->lock);
+    ring_read(window, limit);
+}
+
+// Envia os pacotes já lidos que cabem na cwnd e no saldo do pacer numa única
+// rajada. Chamado com o lock da janela; retorna quantos foram enviados
+static int sender_send_window(SlidingWindow *window)
+{
+    int sent = 0;
+    long long now = now_ns();
+    pacer_set_rate(&window->pacer, &window->cc, &window->rtt);
+
+    while (sender_can_send(window)) {
+        int idx = window->next_seq_num % RING_SIZE;
+        RingSlot *slot = &window->slots[idx];
+        if (!pacer_take(&window->pacer, slot->data_len, now)) break;
+
+        window->acked[idx] = 0;
+        window->retransmitted[idx] = 0;
+        window->send_times[idx] = now;
+
+        batch_add_data(window->sockfd, &window->tx, window->session_id, window->next_seq_num,
+                       slot->checksum, slot->payload, slot->data_len,
+                       &window->peer_addr, window->addr_len);
+
+        // Bloco completo: as paridades seguem na mesma rajada, pagam fichas
+        // do pacer e ocupam a cwnd até a base passar do bloco
+        if (window->fec) {
+            unsigned long long parities = window->fec->parities;
+            pacer_charge(&window->pacer,
+                         fec_on_send(window->fec, window->sockfd, &window->tx, window->session_id,
+                                     window->next_seq_num, slot->payload, slot->data_len,
+                                     window->total_packets - 1, &window->peer_addr,
+                                     window->addr_len));
+            window->parity[idx] = (unsigned char)(window->fec->parities - parities);
+            window->parity_inflight += window->parity[idx];
+        }
+
+        LOG(LOG_PACKET, "📤 Enviado seq=%d [base=%d, janela=%d-%d]\n",
+            window->next_seq_num, window->base,
+            window->base, sender_window_edge(window) - 1);
+
+        window->next_seq_num++;
+        sent++;
+    }
+    batch_flush(window->sockfd, &window->tx);
+    TELEMETRY_ADD(window->stats, packets, sent);
+    TELEMETRY_SET(window->stats, window, window->next_seq_num - window->base);
+    return sent;
+}
+
+// Instante (now_ns()) em que o pacer libera o próximo envio, se é só ele que
+// segura a janela; 0 se não há o que enviar ou se o envio já pode sair
+static long long sender_paced_until(const SlidingWindow *window, long long now)
+{
+    if (!sender_can_send(window) || window->pacer.tokens >= 0) return 0;
+    return pacer_next_ns(&window->pacer, now);
+}
+
+// Janela cheia e leitura antecipada completa: só um ACK destrava o envio
+static int sender_blocked(const SlidingWindow *window)
+{
+    return window->base < window->total_packets &&
+           !sender_can_send(window) &&
+           !(window->read_seq < window->base + RING_SIZE &&
+             window->read_seq < window->total_packets);
+}
+
+// Laço de envio de uma transferência com threads (sender_start): lê à
+// frente, envia o que a janela e o pacer permitem e espera ACKs até todos os
+// pacotes serem confirmados
+static void sender_run(SlidingWindow *window)
+{
+    while (window->base < window->total_packets) {
+        fill_ring(window);
+
+        pthread_mutex_lock(&window->lock);
+        if (sender_send_window(window) > 0) {
+            pthread_cond_signal(&window->timer_cond);
+        }
+
+        // Janela cheia e leitura antecipada completa: espera um ACK
+        while (sender_blocked(window)) {
+            pthread_cond_wait(&window->ack_cond, &window->lock);
+        }
+
+        // Sem fichas no pacer: dorme até a próxima (ou até um ACK)
+        long long paced = sender_paced_until(window, now_ns());
+        if (paced > 0) {
+            struct timespec ts;
+            ns_to_timespec(paced, &ts);
+            pthread_cond_timedwait(&window->ack_cond, &window->lock, &ts);
+        }
+        pthread_mutex_unlock(&window->lock);
+    }
+}
+
+// Fim de uma transferência com threads: a janela já drenou, então o END sai
+// uma vez e é repetido a cada RTO (com backoff) até a resposta do receptor.
+// Retorna end_status: 1 confirmado, -1 recusado, 0 sem resposta
+static int sender_close(SlidingWindow *window)
+{
+    Packet end_pkt;
+    memset(&end_pkt, 0, sizeof(Packet));
+    end_pkt.type = PKT_END;
+    end_pkt.session_id = window->session_id;
+    end_pkt.seq_num = window->total_packets;
+
+    pthread_mutex_lock(&window->lock);
+    long long give_up = now_ns() + END_TIMEOUT_NS;
+    for (int i = 0; i < END_MAX_TRIES && window->end_status == 0 && now_ns() < give_up; i++) {
+        if (i > 0) rtt_on_timeout(&window->rtt);
+        send_packet(window->sockfd, &end_pkt, &window->peer_addr, window->addr_len);
+        long long deadline = now_ns() + rtt_rto_ns(&window->rtt);
+        struct timespec ts;
+        ns_to_timespec(deadline < give_up ? deadline : give_up, &ts);
+        while (window->end_status == 0 &&
+               pthread_cond_timedwait(&window->ack_cond, &window->lock, &ts) != ETIMEDOUT) {
+        }
+    }
+    int end_status = window->end_status;
+    pthread_mutex_unlock(&window->lock);
+    return end_status;
+}
+
+#endif
@@ -2,8 +2,44 @@
     FTP Server com UDP - Slinding Window
     Suporta upload e download de arquivos com threads paralelas
     - Socket dedicado por thread
-    - Checksum CRC32 para integridade
-    - Timeout adaptativo
+    - Checksum CRC32 para integridade (acelerado, ver ../checksum.h)
+    - Formato compacto no fio (ver ../protocol.h)
+    - E/S em lote: rajadas com sendmmsg e recepção com recvmmsg (ver ../batch_io.h)
+    - Offload opcional (--gso): UDP_SEGMENT no envio e UDP_GRO na recepção (Linux)
+    - Timeout adaptativo: RTT em ns com regra de Karn e RTO da RFC 6298 (ver ../rtt.h)
+    - Envio em streaming (memória proporcional à janela, não ao arquivo)
+    - Payload sem cópia: arquivo mapeado e datagramas montados por iovec (ver file_source.h)
+    - Recepção direta: pwrite no offset de cada pacote e bitmap da janela (ver file_sink.h)
+    - Retomada: upload interrompido continua do checkpoint (ver ../checkpoint.h)
+    - Upload por delta: assinatura de received_<nome> e remontagem a partir do
+      delta enviado pelo cliente (ver delta.h)
+    - Janela dinâmica com controle de congestionamento (--cc reno|cubic|delay)
+    - Modo reactor (--reactor [N]): N laços epoll multiplexam todas as sessões
+      na porta do servidor, com número fixo de threads (Linux)
+    - Telemetria por sessão (--stats <arquivo>): contadores exportados em
+      formato Prometheus, regravados a cada segundo (ver ../telemetry.h)
+    - Log assíncrono (ver ../log.h): por pacote só com --verbose
+    - Retransmissão rápida (RACK) e tail loss probe; o timeout é o último recurso
+      (ver loss_recovery.h)
+    - Pacing: envios espalhados à taxa cwnd/SRTT, limite por sessão com
+      --rate <Mbit/s> (ver pacing.h)
+    - Métricas do caminho (RTT, cwnd, ssthresh) herdadas entre downloads do
+      mesmo cliente, para lotes de arquivos pequenos (ver path_cache.h)
+    - Cache LRU de arquivos empacotados (conteúdo + checksums) compartilhado
+      pelos downloads do mesmo arquivo, ligado com --cache <MB> (ver file_cache.h)
+    - FEC (--fec): paridade XOR/Reed-Solomon por bloco nos downloads, com
+      redundância adaptada à perda medida; uploads com FEC são reconstruídos
+      sem retransmissão (ver fec.h)
+    - Encerramento sem espera fixa: END repetido a cada RTO até o ACK do
+      cliente; ENDs repetidos de um upload respondidos por END_LINGER_MS
+    - Início 0-RTT: a primeira janela de um download é a resposta à
+      requisição, enviada pela thread do download assim que abre o arquivo e
+      antes de ler o resto do anel (download_start); DOWNLOAD_SPARES threads
+      ficam à espera com o socket já ligado, então a requisição não paga
+      criação de thread nem bind
+    - Controle de fluxo: os ACKs anunciam o espaço livre do receptor (rwnd) e
+      o envio para em min(cwnd, rwnd), com um pacote de sonda se fechar
+      (ver file_sink.h)
 */
 #include <stdio.h>
 #include <string.h>
@@ -12,55 +48,39 @@
 #include <sys/socket.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <netdb.h>
 #include <sys/time.h>
+#include <sys/stat.h>
 #include <cmath>
 #include <ifaddrs.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#include "../protocol.h"
+#include "../checksum.h"
+#include "../batch_io.h"
+#include "../log.h"
+#include "../rtt.h"
+#include "congestion.h"
+#include "loss_recovery.h"
+#include "pacing.h"
+#include "path_cache.h"
+#include "file_source.h"
+#include "file_sink.h"
+#include "file_cache.h"
+#include "fec.h"
+#include "sender.h"
+#include "delta.h"
 
-#define BUFLEN 1024
 #define PORT 9999
 #define INITIAL_TIMEOUT_SEC 5
 #define MAX_RETRIES 5
-#define ALPHA 0.125  // Fator para RTT médio (usado em timeout adaptativo)
-#define BETA 0.25    // Fator para variação de RTT
-#define WINDOW_SIZE 5  // Tamanho da janela deslizante
-
-// Tipos de pacotes
-#define PKT_UPLOAD_REQUEST 1
-#define PKT_DOWNLOAD_REQUEST 2
-#define PKT_DATA 3
-#define PKT_ACK 4
-#define PKT_END 5
-#define PKT_ERROR 6
-
-// Estrutura do pacote com checksum
-typedef struct {
-    int type;
-    int seq_num;
-    int data_len;
-    char filename[256];
-    char data[BUFLEN];
-    unsigned int checksum;
-} Packet;
-
-// Estrutura de janela deslizante
-typedef struct {
-    Packet packets[WINDOW_SIZE];       // Buffer de pacotes
-    long long send_times[WINDOW_SIZE]; // Timestamps de envio
-    int acked[WINDOW_SIZE];             // ACKs recebidos
-    int base;                           // Início da janela
-    int next_seq_num;                   // Próximo a enviar
-    int total_packets;                  // Total de pacotes
-    pthread_mutex_t lock;               // Mutex para sincronização
-    int sockfd;
-    struct sockaddr_in client_addr;
-    socklen_t addr_len;
-    int finished;                       // Flag para encerrar threads
-    double estimated_rtt;
-    double dev_rtt;
-} SlidingWindow;
+#define END_LINGER_MS 2000          // Upload: ENDs repetidos ainda respondidos até este silêncio
+#define DOWNLOAD_SPARES 4           // Threads de download à espera da próxima requisição
 
 // Estrutura para thread de upload com buffer
 typedef struct {
@@ -68,162 +88,278 @@ typedef struct {
     socklen_t addr_len;
     int sockfd;
     Packet request;
+    SlidingWindow *window;              // Download: janela criada por download_start
+    int fd;                             // Download: arquivo servido
+    int first;                          // Download: primeiro pacote da faixa
+    long long size;                     // Download: tamanho do arquivo
+    IoStats io_start;                   // Download: contadores de E/S no início
 } ThreadArgs;
 
+// Thread de download de reserva, parada com o socket (porta efêmera) já
+// ligado e a janela já alocada até o laço principal entregar uma requisição
+// (download_dispatch)
+typedef struct SpareDownload {
+    int sockfd;
+    SlidingWindow *window;              // Zerada com as páginas já tocadas
+    ThreadArgs *args;                   // Requisição entregue (NULL: à espera)
+    pthread_cond_t cond;
+    struct SpareDownload *next;
+} SpareDownload;
+
+static pthread_mutex_t spare_lock = PTHREAD_MUTEX_INITIALIZER;
+static SpareDownload *spare_list = NULL;
+static int spare_count = 0;
+
+// Algoritmo de controle de congestionamento das sessões (--cc)
+static const CongestionOps *cc_ops = &cc_algorithms[0];
+
 void die(const char *s)
 {
     perror(s);
     exit(1);
 }
 
-// Calcular CRC32 simples (checksum)
-unsigned int calculate_checksum(const char *data, int len)
+// Lê só o que a cwnd já permite enviar: o início de um download não espera
+// a leitura antecipada do anel inteiro (o resto é lido com a janela em voo)
+void fill_window(SlidingWindow *window)
 {
-    unsigned int crc = 0xFFFFFFFF;
-    for (int i = 0; i < len; i++) {
-        crc ^= (unsigned char)data[i];
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1)
-                crc = (crc >> 1) ^ 0xEDB88320;
-            else
-                crc >>= 1;
-        }
+    pthread_mutex_lock(&window->lock);
+    int limit = sender_window_edge(window);
+    if (limit > window->base + RING_SIZE) limit = window->base + RING_SIZE;
+    pthread_mutex_unlock(&window->lock);
+    ring_read(window, limit);
+}
+
+// Função para enviar ACK (cumulativo + SACK, janela anunciada e o total
+// reconstruído pela FEC)
+void send_ack(int sockfd, uint32_t session_id, int seq_num, int cum_ack, uint64_t sack_bits, 
+              int rwnd, uint32_t recovered, const struct sockaddr_in *addr, socklen_t addr_len)
+{
+    Packet ack;
+    memset(&ack, 0, sizeof(Packet));
+    ack.type = PKT_ACK;
+    ack.session_id = session_id;
+    ack.seq_num = seq_num;
+    ack.cum_ack = cum_ack;
+    ack.sack_bits = sack_bits;
+    ack.rwnd = rwnd;
+    ack.fec_recovered = recovered;
+    
+    send_packet(sockfd, &ack, addr, addr_len);
+    LOG(LOG_PACKET, "  ACK enviado para seq=%d (cum=%d, rwnd=%d)\n", seq_num, cum_ack, rwnd);
+}
+
+// Responde a requisição com uma mensagem de erro
+void send_error(int sockfd, uint32_t session_id, const char *message,
+                const struct sockaddr_in *addr, socklen_t addr_len)
+{
+    Packet error_pkt;
+    memset(&error_pkt, 0, sizeof(Packet));
+    error_pkt.type = PKT_ERROR;
+    error_pkt.session_id = session_id;
+    strncpy(error_pkt.data, message, BUFLEN - 1);
+    error_pkt.data_len = strlen(error_pkt.data);
+    send_packet(sockfd, &error_pkt, addr, addr_len);
+}
+
+// Resposta do STAT_REQUEST: ACK com o total de pacotes e o tamanho em bytes
+void send_stat(int sockfd, const Packet *req, const struct sockaddr_in *addr, socklen_t addr_len)
+{
+    struct stat st;
+    if (stat(req->filename, &st) == -1 || !S_ISREG(st.st_mode)) {
+        send_error(sockfd, req->session_id, "Arquivo nao encontrado", addr, addr_len);
+        return;
     }
-    return ~crc;
+    int total_packets = (int)((st.st_size + BUFLEN - 1) / BUFLEN);
+    send_ack(sockfd, req->session_id, 0, total_packets, (uint64_t)st.st_size, 0, 0, addr, addr_len);
 }
 
-// timestamp em milissegundos
-long long get_timestamp_ms()
+// Faixa [first, end) pedida no DOWNLOAD_REQUEST, limitada ao arquivo
+void request_range(const Packet *req, int total_packets, int *first, int *end)
 {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (long long)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
+    *end = total_packets;
+    if (req->range_end > 0 && req->range_end < total_packets) *end = req->range_end;
+    *first = req->range_first < *end ? req->range_first : *end;
 }
 
-// Thread para RECEBER ACKs (download com Selective Repeat)
-void* thread_receive_acks(void* arg)
+// Bytes da faixa [first, end) de um arquivo de size bytes
+long long range_bytes(long long size, int first, int end)
 {
-    SlidingWindow *window = (SlidingWindow*)arg;
-    Packet ack;
-    
-    struct timeval tv;
-    tv.tv_sec = 0;
-    tv.tv_usec = 100000; // 100ms timeout
-    setsockopt(window->sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    long long last = (long long)end * BUFLEN < size ? (long long)end * BUFLEN : size;
+    return last - (long long)first * BUFLEN;
+}
+
+// Retomada de download: o hash dos pacotes [0, first) que o cliente já tem
+// precisa bater com o arquivo atual; senão a retomada é recusada
+int resume_verify(const Packet *req, int fd, int first)
+{
+    if (!req->resume || first == 0) return 0;
+    uint32_t hash;
+    if (resume_hash_file(fd, first, &hash) == -1 || hash != req->resume_hash) return -1;
+    return 0;
+}
+
+// Tipo da transferência nos rótulos da telemetria
+const char *transfer_kind(int type)
+{
+    switch (type) {
+    case PKT_DOWNLOAD_REQUEST:  return "download";
+    case PKT_UPLOAD_REQUEST:    return "upload";
+    case PKT_SIGNATURE_REQUEST: return "signature";
+    case PKT_DELTA_REQUEST:     return "delta";
+    }
+    return "?";
+}
+
+// Arquivo servido por uma requisição de download: o próprio arquivo ou, na
+// assinatura de um upload por delta, um temporário com a de received_<nome>
+int download_open(const Packet *req)
+{
+    if (req->type != PKT_SIGNATURE_REQUEST) return open(req->filename, O_RDONLY);
     
-    while (!window->finished) {
-        //janela não fechada > envia dados
-        memset(&ack, 0, sizeof(Packet));
-        
-        int recv_len = recvfrom(window->sockfd, &ack, sizeof(Packet), 0, 
-                                (struct sockaddr*)&window->client_addr, &window->addr_len);
-        
-        if (recv_len > 0 && ack.type == PKT_ACK) {
-            pthread_mutex_lock(&window->lock);
-            
-            int seq = ack.seq_num;
-            int idx = seq % WINDOW_SIZE;
-            
-            // Marcar pacote como confirmado
-            if (seq >= window->base && seq < window->next_seq_num) {
-                if (!window->acked[idx]) {
-                    window->acked[idx] = 1;
-                    
-                    // Calcular RTT
-                    long long now = get_timestamp_ms();
-                    double sample_rtt = (now - window->send_times[idx]) / 1000.0;
-                    
-                    window->dev_rtt = (1 - BETA) * window->dev_rtt + 
-                                      BETA * fabs(sample_rtt - window->estimated_rtt);
-                    window->estimated_rtt = (1 - ALPHA) * window->estimated_rtt + 
-                                           ALPHA * sample_rtt;
-                    
-                    printf("  ✓ ACK recebido seq=%d (RTT=%.3fs)\n", seq, sample_rtt);
-                }
-                
-                // Deslizar janela se o base foi confirmado
-                while (window->acked[window->base % WINDOW_SIZE] && 
-                       window->base < window->total_packets) {
-                    window->acked[window->base % WINDOW_SIZE] = 0;
-                    window->base++;
-                    printf("  🔄 Janela deslizada → base=%d\n", window->base);
-                }
-            }
-            
-            pthread_mutex_unlock(&window->lock);
-        }
+    char path[300];
+    snprintf(path, sizeof(path), "received_%s", req->filename);
+    int basis = open(path, O_RDONLY);
+    if (basis == -1) return -1;
+    int fd = delta_signature(basis);
+    close(basis);
+    return fd;
+}
+
+// Onde um upload é gravado: received_<nome>, ou ao lado dele o delta, que só
+// substitui a versão atual depois de aplicado (delta_commit)
+void upload_path(const Packet *req, char *path, size_t size)
+{
+    if (req->type == PKT_DELTA_REQUEST) {
+        snprintf(path, size, "received_%s.delta", req->filename);
+    } else {
+        snprintf(path, size, "received_%s", req->filename);
     }
-    //janela fechada > null
-    return NULL;
 }
 
-// Thread para VERIFICAR TIMEOUTS e RETRANSMITIR
-void* thread_check_timeouts(void* arg)
+// Abre o arquivo de um upload (leitura e escrita: a FEC relê os pacotes já
+// gravados). Com retomada pedida e checkpoint válido o arquivo parcial é
+// mantido e o sink continua dali; senão recomeça do zero (o delta é pequeno
+// e sempre recomeça, sem checkpoint)
+int upload_open(const Packet *req, const char *path, FileSink *sink, const char *tag)
 {
-    SlidingWindow *window = (SlidingWindow*)arg;
+    if (req->type == PKT_DELTA_REQUEST) {
+        int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+        if (fd != -1) sink_init(sink, fd, 0, tag);
+        return fd;
+    }
     
-    while (!window->finished) {
-        usleep(100000); // 100ms
-        
-        pthread_mutex_lock(&window->lock);
-        
-        long long now = get_timestamp_ms();
-        int timeout_ms = (int)((window->estimated_rtt + 4 * window->dev_rtt) * 1000);
-        if (timeout_ms < 500) timeout_ms = 500;
-        if (timeout_ms > 5000) timeout_ms = 5000;
-        
-        // Verificar cada pacote na janela
-        for (int seq = window->base; seq < window->next_seq_num; seq++) {
-            int idx = seq % WINDOW_SIZE;
-            
-            if (!window->acked[idx] && 
-                (now - window->send_times[idx]) > timeout_ms) { //se não teve ack e não deu timeout ainda
-                
-                // RETRANSMITIR apenas este pacote (Selective Repeat)
-                Packet *pkt = &window->packets[idx];
-                sendto(window->sockfd, pkt, sizeof(Packet), 0, 
-                       (struct sockaddr*)&window->client_addr, window->addr_len);
-                
-                window->send_times[idx] = now;
-                
-                printf("  🔄 Retransmitindo seq=%d (timeout=%dms)\n", seq, timeout_ms);
-            }
+    Checkpoint ck;
+    if (req->resume && checkpoint_load(path, &ck) == 0) {
+        int fd = open(path, O_RDWR);
+        if (fd != -1) {
+            sink_init(sink, fd, 0, tag);
+            sink_restore(sink, &ck);
+            sink_enable_checkpoint(sink, path);
+            printf("%s↻ Retomando do pacote %d\n", tag, sink->base);
+            return fd;
         }
-        
-        pthread_mutex_unlock(&window->lock);
     }
     
-    return NULL;
+    checkpoint_remove(path);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd == -1) return -1;
+    sink_init(sink, fd, 0, tag);
+    sink_enable_checkpoint(sink, path);
+    return fd;
 }
 
-// Função para enviar ACK
-void send_ack(int sockfd, int seq_num, struct sockaddr_in *addr, socklen_t addr_len)
+// Fim de um upload por delta: remonta received_<nome> a partir da versão atual
+// e do delta recebido em delta_fd. Retorna -1 se o delta não puder ser aplicado
+int delta_commit(const char *filename, int delta_fd, const char *delta_path, const char *tag)
+{
+    char path[300], tmp[310];
+    snprintf(path, sizeof(path), "received_%s", filename);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    
+    int basis = open(path, O_RDONLY);
+    long long size = basis == -1 ? -1 : delta_apply(basis, delta_fd, tmp);
+    if (basis != -1) close(basis);
+    unlink(delta_path);
+    
+    if (size == -1 || rename(tmp, path) == -1) {
+        printf("%s❌ Delta não pôde ser aplicado, versão atual mantida: %s\n", tag, path);
+        unlink(tmp);
+        return -1;
+    }
+    checkpoint_remove(path);
+    printf("%s🧩 Delta aplicado: %s (%lld bytes)\n", tag, path, size);
+    return 0;
+}
+
+// ACK da requisição de upload: ponto de retomada (cum_ack + SACK) e hash do
+// prefixo já recebido no campo de checksum (base 0 num upload novo)
+void send_upload_ack(int sockfd, uint32_t session_id, const FileSink *sink,
+                     const struct sockaddr_in *addr, socklen_t addr_len)
 {
     Packet ack;
     memset(&ack, 0, sizeof(Packet));
     ack.type = PKT_ACK;
-    ack.seq_num = seq_num;
-    
-    sendto(sockfd, &ack, sizeof(Packet), 0, (struct sockaddr*)addr, addr_len);
-    printf("  ACK enviado para seq=%d\n", seq_num);
+    ack.session_id = session_id;
+    ack.seq_num = 0;
+    ack.cum_ack = sink->base;
+    ack.sack_bits = sink_sack_bitmap(sink);
+    ack.checksum = sink->prefix_hash;
+    send_packet(sockfd, &ack, addr, addr_len);
 }
 
-// DOWNLOAD com Sliding Window (Selective Repeat)
-void* thread_download(void* arg)
+// Resposta ao END de um upload: ACK com o seq do END, ou ERROR se o delta
+// não pôde ser aplicado (reply -1). Repetida a cada END que chegar de novo
+void send_end_reply(int sockfd, uint32_t session_id, int reply, int seq, int cum_ack,
+                    uint32_t recovered, const struct sockaddr_in *addr, socklen_t addr_len)
 {
-    ThreadArgs *args = (ThreadArgs*)arg;
-    pthread_detach(pthread_self());
+    if (reply == -1) {
+        send_error(sockfd, session_id, DELTA_FAILED_MSG, addr, addr_len);
+    } else {
+        send_ack(sockfd, session_id, seq, cum_ack, 0, 0, recovered, addr, addr_len);
+    }
+}
+
+// Janela de envio de um download dos pacotes [first, end) do arquivo aberto em fd
+// (no heap: o anel é dimensionado pela janela máxima). Com cache_path o payload
+// vem do cache de arquivos; sem entrada (ou sem cache_path) o arquivo é mapeado.
+// window: memória zerada reservada antes (thread de reserva), ou NULL para alocar
+SlidingWindow *window_create(SlidingWindow *window, int sockfd, const struct sockaddr_in *addr,
+                             socklen_t addr_len, uint32_t session_id, int fd, int first, int end,
+                             const char *cache_path)
+{
+    if (!window) window = (SlidingWindow*)calloc(1, sizeof(SlidingWindow));
+    if (!window) return NULL;
+    if (cache_path) window->cache = cache_acquire(cache_path, fd, &window->cache_hit);
+    if (!window->cache && source_open(&window->source, fd, RING_SIZE) == -1) {
+        free(window);
+        return NULL;
+    }
     
-    printf("\n[DOWNLOAD] Thread iniciada para arquivo: %s\n", args->request.filename);
-    printf("[DOWNLOAD] Cliente: %s:%d (Selective Repeat)\n", 
-           inet_ntoa(args->client_addr.sin_addr), ntohs(args->client_addr.sin_port));
+    // Sem mapeamento os blocos são lidos em sequência a partir do início da faixa
+    if (!window->cache && !window->source.map && first > 0) lseek(fd, (off_t)first * BUFLEN, SEEK_SET);
     
-    // Socket dedicado
+    sender_init(window, sockfd, addr, addr_len, session_id, first, end, cc_ops);
+    return window;
+}
+
+// Linha do log sobre o cache no início de um download
+void cache_log(const char *tag, const SlidingWindow *window)
+{
+    if (!window->cache) return;
+    char summary[160];
+    cache_summary(summary, sizeof(summary));
+    printf("%s🗃️  Cache %s | %s\n", tag, window->cache_hit ? "acerto" : "falta", summary);
+}
+
+// Socket próprio de um download, numa porta efêmera que o cliente aprende
+// pelo remetente dos pacotes DATA
+int download_socket()
+{
     int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
     if (sockfd == -1) {
-        perror("socket thread_download");
-        free(args);
-        return NULL;
+        perror("socket download_socket");
+        return -1;
     }
     
     struct sockaddr_in local_addr;
@@ -233,137 +369,219 @@ void* thread_download(void* arg)
     local_addr.sin_addr.s_addr = INADDR_ANY;
     
     if (bind(sockfd, (struct sockaddr*)&local_addr, sizeof(local_addr)) == -1) {
-        perror("bind thread_download");
+        perror("bind download_socket");
         close(sockfd);
-        free(args);
-        return NULL;
+        return -1;
     }
+    pacing_limit_socket(sockfd);
+    return sockfd;
+}
+
+// Início de um download (0-RTT) no socket já ligado: arquivo, janela e já a
+// primeira janela de dados, que é a resposta à requisição. Leitura
+// antecipada, threads e mensagens ficam para depois. Retorna -1 se a
+// requisição foi recusada (com o erro enviado ao cliente e sockfd fechado)
+int download_start(ThreadArgs *args, int sockfd)
+{
+    args->io_start = io_stats;
     
-    // Abrir arquivo
-    int fd = open(args->request.filename, O_RDONLY);
+    // Abrir arquivo (ou a assinatura dele, no upload por delta)
+    int fd = download_open(&args->request);
     if (fd == -1) {
         printf("[DOWNLOAD] Erro ao abrir arquivo: %s\n", args->request.filename);
-        Packet error_pkt;
-        memset(&error_pkt, 0, sizeof(Packet));
-        error_pkt.type = PKT_ERROR;
-        strcpy(error_pkt.data, "Arquivo nao encontrado");
-        sendto(sockfd, &error_pkt, sizeof(Packet), 0, 
-               (struct sockaddr*)&args->client_addr, args->addr_len);
+        send_error(sockfd, args->request.session_id, "Arquivo nao encontrado",
+                   &args->client_addr, args->addr_len);
         close(sockfd);
-        free(args);
-        return NULL;
+        return -1;
     }
     
-    // Ler todos os pacotes do arquivo (buffer dinâmico)
-    Packet *all_packets = (Packet*)malloc(1000 * sizeof(Packet));
-    if (!all_packets) {
-        printf("[DOWNLOAD] Erro ao alocar memória\n");
+    // Total de pacotes a partir do tamanho do arquivo (leitura sob demanda)
+    struct stat st;
+    fstat(fd, &st);
+    int total_packets = (int)((st.st_size + BUFLEN - 1) / BUFLEN);
+    int first, end;
+    request_range(&args->request, total_packets, &first, &end);
+    
+    if (resume_verify(&args->request, fd, first) == -1) {
+        printf("[DOWNLOAD] ❌ Checkpoint do cliente não confere, retomada recusada\n");
+        send_error(sockfd, args->request.session_id, RESUME_MISMATCH_MSG,
+                   &args->client_addr, args->addr_len);
         close(fd);
         close(sockfd);
-        free(args);
-        return NULL;
+        return -1;
     }
     
-    int total_packets = 0;
-    int bytes_read;
-    
-    //enquanto estiver lendo dados
-    while ((bytes_read = read(fd, all_packets[total_packets].data, BUFLEN)) > 0) {
-        all_packets[total_packets].type = PKT_DATA;
-        all_packets[total_packets].seq_num = total_packets;
-        all_packets[total_packets].data_len = bytes_read;
-        all_packets[total_packets].checksum = 
-            calculate_checksum(all_packets[total_packets].data, bytes_read);
-        total_packets++;
-        if (total_packets >= 1000) break;
+    // Inicializar janela deslizante
+    SlidingWindow *window = window_create(args->window, sockfd, &args->client_addr, args->addr_len,
+                                          args->request.session_id, fd, first, end,
+                                          args->request.type == PKT_DOWNLOAD_REQUEST ?
+                                          args->request.filename : NULL);
+    args->window = window;
+    if (!window) {
+        printf("[DOWNLOAD] Erro ao alocar memória\n");
+        close(fd);
+        close(sockfd);
+        return -1;
     }
-    close(fd);
+    window->stats = telemetry_begin(transfer_kind(args->request.type), args->request.session_id,
+                                    args->request.filename, &args->client_addr);
     
-    printf("[DOWNLOAD] 📦 Total: %d pacotes | 📊 Janela: %d\n\n", 
-           total_packets, WINDOW_SIZE);
+    fill_window(window);
+    sender_send_window(window);
     
-    // Inicializar janela deslizante
-    SlidingWindow window;
-    memset(&window, 0, sizeof(SlidingWindow));
-    window.base = 0;
-    window.next_seq_num = 0;
-    window.total_packets = total_packets;
-    window.sockfd = sockfd;
-    window.client_addr = args->client_addr;
-    window.addr_len = args->addr_len;
-    window.finished = 0;
-    window.estimated_rtt = 1.0;
-    window.dev_rtt = 0.5;
-    pthread_mutex_init(&window.lock, NULL);
-    
-    // Criar threads para ACKs e timeouts
-    pthread_t tid_ack, tid_timeout;
-    pthread_create(&tid_ack, NULL, thread_receive_acks, &window);
-    pthread_create(&tid_timeout, NULL, thread_check_timeouts, &window);
-    
-    // LOOP PRINCIPAL: Enviar pacotes conforme janela permite
-    while (window.base < total_packets) {
-        pthread_mutex_lock(&window.lock);
-        
-        // Enviar pacotes se houver espaço na janela
-        while (window.next_seq_num < window.base + WINDOW_SIZE && 
-               window.next_seq_num < total_packets) {
-            
-            int idx = window.next_seq_num % WINDOW_SIZE;
-            window.packets[idx] = all_packets[window.next_seq_num];
-            window.acked[idx] = 0;
-            window.send_times[idx] = get_timestamp_ms();
-            
-            sendto(sockfd, &window.packets[idx], sizeof(Packet), 0, 
-                   (struct sockaddr*)&window.client_addr, window.addr_len);
-            
-            printf("📤 Enviado seq=%d [base=%d, janela=%d-%d]\n", 
-                   window.next_seq_num, window.base, 
-                   window.base, window.base + WINDOW_SIZE - 1);
-            
-            window.next_seq_num++;
-        }
-        
-        pthread_mutex_unlock(&window.lock);
-        usleep(10000); // 10ms
+    args->window = window;
+    args->fd = fd;
+    args->first = first;
+    args->size = st.st_size;
+    return 0;
+}
+
+void* thread_download(void* arg);
+
+// Completa as reservas (spare_count conta também as que ainda estão se preparando)
+void spare_refill()
+{
+    pthread_mutex_lock(&spare_lock);
+    while (spare_count < DOWNLOAD_SPARES) {
+        pthread_t thread_id;
+        if (pthread_create(&thread_id, NULL, thread_download, NULL) != 0) break;
+        spare_count++;
     }
+    pthread_mutex_unlock(&spare_lock);
+}
+
+// DOWNLOAD com Sliding Window (Selective Repeat). A primeira janela sai
+// antes das mensagens, da leitura antecipada (download_start) e da reposição
+// da reserva consumida
+void download_run(ThreadArgs *args, int sockfd)
+{
+    if (download_start(args, sockfd) == -1) {
+        free(args->window);
+        free(args);
+        spare_refill();
+        return;
+    }
+    // A primeira janela já saiu: cede a CPU para o cliente recebê-la antes
+    // da reposição da reserva, das mensagens e da leitura do resto do anel
+    sched_yield();
+    spare_refill();
+    SlidingWindow *window = args->window;
+    int fd = args->fd;
+    int first = args->first;
+    int total_packets = window->total_packets;
+    int file_packets = (int)((args->size + BUFLEN - 1) / BUFLEN);
     
-    printf("\n⏳ Aguardando ACKs finais...\n");
-    sleep(2);
+    printf("\n[DOWNLOAD] Thread iniciada para arquivo: %s\n", args->request.filename);
+    printf("[DOWNLOAD] Cliente: %s:%d (Selective Repeat)\n", 
+           inet_ntoa(args->client_addr.sin_addr), ntohs(args->client_addr.sin_port));
+    printf("[DOWNLOAD] 📦 Total: %d pacotes | 📊 Janela máx: %d (%s)\n", 
+           file_packets, MAX_WINDOW, cc_ops->name);
+    if (first > 0 || total_packets < file_packets) {
+        printf("[DOWNLOAD] ✂️  Faixa: pacotes %d a %d\n", first, total_packets - 1);
+    }
+    printf("\n");
+    cache_log("[DOWNLOAD] ", window);
     
-    // Enviar pacote END
-    Packet end_pkt;
-    memset(&end_pkt, 0, sizeof(Packet));
-    end_pkt.type = PKT_END;
-    end_pkt.seq_num = total_packets;
+    // Threads de ACKs e timeouts; este laço lê e envia até a janela drenar
+    sender_start(window);
+    sender_run(window);
+    close(fd);
+    total_packets = window->total_packets;
     
     printf("Enviando pacote END...\n");
-    for (int i = 0; i < 3; i++) {
-        sendto(sockfd, &end_pkt, sizeof(Packet), 0, 
-               (struct sockaddr*)&window.client_addr, window.addr_len);
-        usleep(100000);
-    }
-    
-    // Encerrar threads
-    window.finished = 1;
-    pthread_join(tid_ack, NULL);
-    pthread_join(tid_timeout, NULL);
-    pthread_mutex_destroy(&window.lock);
+    if (sender_close(window) != 1) printf("[DOWNLOAD] ⚠️  END sem confirmação do cliente\n");
+    sender_stop(window);
     
     printf("\n[DOWNLOAD] ✓ Transferência concluída: %s (%d pacotes)\n", 
-           args->request.filename, total_packets);
+           args->request.filename, total_packets - first);
+    fec_encoder_report("[DOWNLOAD] ", window->fec);
+    io_report("[DOWNLOAD] ", &args->io_start, range_bytes(args->size, first, total_packets));
     
+    telemetry_end(window->stats);
     close(sockfd);
-    free(all_packets);
+    sender_destroy(window);
     free(args);
+}
+
+// Thread de download: atende args (NULL: nasce como reserva, já contada em
+// spare_count) e depois, se faltam reservas, volta a esperar a próxima
+// requisição com um socket novo
+void* thread_download(void* arg)
+{
+    ThreadArgs *args = (ThreadArgs*)arg;
+    pthread_detach(pthread_self());
+    
+    SpareDownload spare;
+    memset(&spare, 0, sizeof(spare));
+    pthread_cond_init(&spare.cond, NULL);
+    int sockfd = args ? download_socket() : -1;
+    
+    while (1) {
+        if (args) {
+            if (sockfd != -1) {
+                download_run(args, sockfd);
+            } else {
+                free(args->window);
+                free(args);
+            }
+            
+            // Volta como reserva só se faltar alguma
+            pthread_mutex_lock(&spare_lock);
+            int full = spare_count >= DOWNLOAD_SPARES;
+            if (!full) spare_count++;
+            pthread_mutex_unlock(&spare_lock);
+            if (full) break;
+        }
+        
+        if ((sockfd = download_socket()) == -1) {
+            pthread_mutex_lock(&spare_lock);
+            spare_count--;
+            pthread_mutex_unlock(&spare_lock);
+            break;
+        }
+        // memset em vez de calloc: as faltas de página ficam fora da requisição
+        spare.window = (SlidingWindow*)malloc(sizeof(SlidingWindow));
+        if (spare.window) memset(spare.window, 0, sizeof(SlidingWindow));
+        
+        pthread_mutex_lock(&spare_lock);
+        spare.sockfd = sockfd;
+        spare.args = NULL;
+        spare.next = spare_list;
+        spare_list = &spare;
+        while (!spare.args) pthread_cond_wait(&spare.cond, &spare_lock);
+        args = spare.args;
+        pthread_mutex_unlock(&spare_lock);
+        args->window = spare.window;
+    }
+    pthread_cond_destroy(&spare.cond);
     return NULL;
 }
 
+// Entrega a requisição a uma thread de reserva; sem reserva livre, cria uma
+static void download_dispatch(ThreadArgs *args)
+{
+    pthread_mutex_lock(&spare_lock);
+    SpareDownload *spare = spare_list;
+    if (spare) {
+        spare_list = spare->next;
+        spare_count--;
+        spare->args = args;
+        pthread_cond_signal(&spare->cond);
+    }
+    pthread_mutex_unlock(&spare_lock);
+    
+    if (!spare) {
+        pthread_t thread_id;
+        pthread_create(&thread_id, NULL, thread_download, args);
+    }
+}
+
 // UPLOAD com Buffer para Recepção Fora de Ordem (Selective Repeat)
 void* thread_upload(void* arg)
 {
     ThreadArgs *args = (ThreadArgs*)arg;
     pthread_detach(pthread_self());
+    uint32_t session_id = args->request.session_id;
     
     printf("\n[UPLOAD] Thread iniciada para arquivo: %s\n", args->request.filename);
     printf("[UPLOAD] Cliente: %s:%d (Selective Repeat)\n", 
@@ -390,132 +608,131 @@ void* thread_upload(void* arg)
         return NULL;
     }
     
+    IoStats io_start = io_stats;
     char upload_filename[300];
-    snprintf(upload_filename, sizeof(upload_filename), "received_%s", args->request.filename);
+    upload_path(&args->request, upload_filename, sizeof(upload_filename));
     
-    int fd = creat(upload_filename, 0666);
+    // Payload vai direto ao offset no arquivo; só o bitmap da janela em memória
+    FileSink sink;
+    int fd = upload_open(&args->request, upload_filename, &sink, "[UPLOAD] ");
     if (fd == -1) {
         printf("[UPLOAD] Erro ao criar arquivo: %s\n", upload_filename);
-        Packet error_pkt;
-        memset(&error_pkt, 0, sizeof(Packet));
-        error_pkt.type = PKT_ERROR;
-        strcpy(error_pkt.data, "Erro ao criar arquivo no servidor");
-        sendto(sockfd, &error_pkt, sizeof(Packet), 0, 
-               (struct sockaddr*)&args->client_addr, args->addr_len);
+        send_error(sockfd, session_id, "Erro ao criar arquivo no servidor",
+                   &args->client_addr, args->addr_len);
         free(args);
         return NULL;
     }
     
-    // Enviar ACK para requisição inicial
-    send_ack(sockfd, 0, &args->client_addr, args->addr_len);
+    sink.stats = telemetry_begin(transfer_kind(args->request.type), session_id,
+                                 args->request.filename, &args->client_addr);
     
-    // Buffer dinâmico para recebimento fora de ordem (evita stack overflow)
-    Packet *buffer = (Packet*)malloc(1000 * sizeof(Packet));
-    int *received = (int*)calloc(1000, sizeof(int));
-    if (!buffer || !received) {
-        printf("[UPLOAD] Erro ao alocar memória\n");
-        close(fd);
-        close(sockfd);
-        if (buffer) free(buffer);
-        if (received) free(received);
-        free(args);
-        return NULL;
-    }
-    int base = 0;
+    // Enviar ACK para requisição inicial (com o ponto de retomada)
+    send_upload_ack(sockfd, session_id, &sink, &args->client_addr, args->addr_len);
     
     struct timeval tv;
     tv.tv_sec = 10;
     tv.tv_usec = 0;
     setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
     
-    while (1) {
-        Packet pkt;
-        memset(&pkt, 0, sizeof(Packet));
-        
-        int recv_len = recvfrom(sockfd, &pkt, sizeof(Packet), 0, 
-                                (struct sockaddr*)&args->client_addr, &args->addr_len);
+    PacketBatch *rx = (PacketBatch*)calloc(1, sizeof(PacketBatch));
+    if (rx && io_offload) batch_enable_gro(sockfd, rx);
+    FecDecoder *fec = NULL;
+    int done = 0;
+    int end_reply = 0;                  // Resposta dada ao END: 1 ACK, -1 ERROR
+    
+    while (rx && !done) {
+        int count = batch_recv(sockfd, rx);
         
-        if (recv_len <= 0) {
+        if (count <= 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 printf("[UPLOAD] ⏰ Timeout\n");
             }
             break;
         }
         
-        printf("[UPLOAD] Recebido tipo=%d seq=%d\n", pkt.type, pkt.seq_num);
-        
-        if (pkt.type == PKT_END) {
-            send_ack(sockfd, pkt.seq_num, &args->client_addr, args->addr_len);
-            printf("[UPLOAD] ✓ Transferência concluída: %s\n", upload_filename);
-            break;
-        }
+        // Um ACK por lote: cum_ack + SACK cobrem todos os pacotes do lote e o
+        // seq do último pacote aceito serve de amostra de RTT ao remetente.
+        // A janela anunciada desconta o que ficou na fila do socket
+        int ack_seq = -1;
+        int room = socket_room(sockfd);
         
-        if (pkt.type == PKT_DATA) {
-            // Verificar checksum
-            unsigned int calc_checksum = calculate_checksum(pkt.data, pkt.data_len);
-            if (pkt.checksum != calc_checksum) {
-                printf("[UPLOAD] ❌ Checksum inválido seq=%d\n", pkt.seq_num);
-                continue;
-            }
-            
-            // Armazenar pacote (mesmo fora de ordem)
-            if (!received[pkt.seq_num]) {
-                buffer[pkt.seq_num] = pkt;
-                received[pkt.seq_num] = 1;
-                printf("[UPLOAD] 📥 Recebido seq=%d ✓ Checksum OK\n", pkt.seq_num);
-            }
+        for (int i = 0; i < count && !done; i++) {
+            Packet pkt;
+            if (batch_packet(rx, i, &pkt) == -1 || pkt.session_id != session_id) continue;
             
-            // Enviar ACK seletivo (sempre ACK do que recebeu)
-            send_ack(sockfd, pkt.seq_num, &args->client_addr, args->addr_len);
+            LOG(LOG_PACKET, "[UPLOAD] Recebido tipo=%d seq=%d\n", pkt.type, pkt.seq_num);
             
-            // Escrever pacotes em ordem no arquivo
-            while (received[base]) {
-                write(fd, buffer[base].data, buffer[base].data_len);
-                printf("[UPLOAD] 💾 Escrito seq=%d no arquivo\n", base);
-                base++;
+            if (pkt.type == PKT_END) {
+                if (ack_seq >= 0) {
+                    send_ack(sockfd, session_id, ack_seq, sink.base, sink_sack_bitmap(&sink), 
+                             sink_rwnd(&sink, room), fec_recovered(fec),
+                             &args->client_addr, args->addr_len);
+                    ack_seq = -1;
+                }
+                
+                // Delta: o ACK do END só sai depois de remontado o arquivo
+                end_reply = args->request.type == PKT_DELTA_REQUEST &&
+                            delta_commit(args->request.filename, fd, upload_filename,
+                                         "[UPLOAD] ") == -1 ? -1 : 1;
+                send_end_reply(sockfd, session_id, end_reply, pkt.seq_num, sink.base,
+                               fec_recovered(fec), &args->client_addr, args->addr_len);
+                printf("[UPLOAD] ✓ Transferência concluída: %s\n", upload_filename);
+                io_report("[UPLOAD] ", &io_start, sink.bytes);
+                done = 1;
+            } else if (pkt.type == PKT_DATA && sink_on_data(&sink, &pkt)) {
+                ack_seq = pkt.seq_num;
+            } else if (pkt.type == PKT_FEC && fec_on_parity(&fec, &sink, &pkt) > 0) {
+                // Reconstruídos: o ACK leva o último pacote do bloco, recém-enviado
+                ack_seq = pkt.seq_num + pkt.fec_k - 1;
             }
         }
+        
+        // ACK cumulativo + SACK (sempre ACK do que recebeu)
+        if (ack_seq >= 0) {
+            send_ack(sockfd, session_id, ack_seq, sink.base, sink_sack_bitmap(&sink), 
+                     sink_rwnd(&sink, room), fec_recovered(fec), &args->client_addr, args->addr_len);
+        }
     }
     
+    sink_finish(&sink, done);
+    telemetry_end(sink.stats);
     close(fd);
+    
+    // Como o TIME_WAIT do TCP: a resposta ao END pode se perder e o cliente
+    // repete o END a cada RTO, então a porta continua respondendo até
+    // END_LINGER_MS sem ENDs novos
+    if (done) {
+        tv.tv_sec = END_LINGER_MS / 1000;
+        tv.tv_usec = (END_LINGER_MS % 1000) * 1000;
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        long long until = now_ns() + END_LINGER_MS * 1000000LL;
+        while (now_ns() < until) {
+            int count = batch_recv(sockfd, rx);
+            if (count <= 0) break;
+            for (int i = 0; i < count; i++) {
+                Packet pkt;
+                if (batch_packet(rx, i, &pkt) == -1 || pkt.session_id != session_id ||
+                    pkt.type != PKT_END) {
+                    continue;
+                }
+                send_end_reply(sockfd, session_id, end_reply, pkt.seq_num, sink.base,
+                               fec_recovered(fec), &args->client_addr, args->addr_len);
+                until = now_ns() + END_LINGER_MS * 1000000LL;
+            }
+        }
+    }
+    
+    if (rx) batch_free(rx);
+    free(rx);
+    fec_decoder_finish(fec, "[UPLOAD] ");
     close(sockfd);
-    free(buffer);
-    free(received);
     free(args);
     return NULL;
 }
 
-int main(void)
+// Exibe TODOS os IPs disponíveis (incluindo IP da rede local)
+void print_addresses()
 {
-    struct sockaddr_in si_me, si_other;
-    int s;
-    socklen_t slen = sizeof(si_other);
-    Packet pkt;
-    
-    printf("═══════════════════════════════════════════\n");
-    printf("   SERVIDOR FTP UDP - SELECTIVE REPEAT\n");
-    printf("   🚀 Janela deslizante: %d pacotes\n", WINDOW_SIZE);
-    printf("   🔄 Reenvio seletivo de pacotes perdidos\n");
-    printf("═══════════════════════════════════════════\n\n");
-    
-    // Criar socket UDP principal (apenas para receber requisições)
-    if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
-        die("socket");
-    }
-    
-    memset((char *)&si_me, 0, sizeof(si_me));
-    
-    si_me.sin_family = AF_INET;
-    si_me.sin_port = htons(PORT);
-    si_me.sin_addr.s_addr = htonl(INADDR_ANY);
-    
-    // Bind
-    if (bind(s, (struct sockaddr*)&si_me, sizeof(si_me)) == -1) {
-        die("bind");
-    }
-    
-    // Obter e exibir TODOS os IPs disponíveis (incluindo IP da rede local)
-    printf("✓ Servidor rodando na porta %d\n\n", PORT);
     printf("IPs disponíveis para conexão:\n");
     printf("─────────────────────────────────────────\n");
     
@@ -556,16 +773,866 @@ int main(void)
         printf(" Certifique-se de estar conectado ao WiFi/Ethernet.\n");
     }
     printf("\n");
+}
+
+#ifdef __linux__
+// ═══ Modo reactor ═══
+// Um laço epoll por núcleo, cada um com o próprio socket na porta PORT
+// (SO_REUSEPORT: o kernel distribui os clientes entre os laços pelo endereço
+// de origem, então todos os pacotes de uma sessão chegam ao mesmo laço).
+// Cada transferência é uma máquina de estados identificada por (endereço do
+// cliente, id da sessão) que reaproveita as funções sender_* e sink_* do
+// modo com threads; retransmissões, ENDs, a espera depois do END de um
+// upload e a ociosidade são prazos em now_ns() num heap; o laço dorme no
+// epoll_pwait2 até o mais próximo, com resolução de nanossegundos (o
+// epoll_wait em ms adiantaria o RTO e o pacer em até 1 ms).
+// O trabalho de arquivo que bloqueia (abrir, hash de retomada, assinatura,
+// fsync do checkpoint, aplicação do delta) vai para um pool de threads; a
+// sessão fica parada até a conclusão chegar ao laço pelo pipe de conclusões.
+
+#define SESSION_BUCKETS 4096
+#define SESSION_IDLE_NS 10000000000LL  // sessão sem pacotes do cliente é descartada (10 s)
+#define END_LINGER_NS (END_LINGER_MS * 1000000LL)
+#define REACTOR_SOCKBUF (4 * 1024 * 1024)
+#define REACTOR_WORKERS 4          // Threads do pool de arquivo (compartilhado pelos laços)
+
+// Trabalhos do pool; JOB_CHECKPOINT não para a sessão, os demais sim
+enum { JOB_DOWNLOAD_OPEN = 1, JOB_UPLOAD_OPEN, JOB_CHECKPOINT, JOB_COMMIT, JOB_ABORT };
+
+typedef struct Session {
+    uint32_t id;
+    struct sockaddr_in addr;
+    socklen_t addr_len;
+    int type;                      // PKT_DOWNLOAD_REQUEST ou PKT_UPLOAD_REQUEST
+    int delta;                     // Upload por delta (aplicado no END)
+    int fd;                        // Arquivo transferido
+    char filename[256];
+    SlidingWindow *window;         // Download: anel de envio
+    FileSink sink;                 // Upload: escrita direta + bitmap da janela
+    FecDecoder *fec;               // Upload: paridades dos blocos com perdas
+    char path[300];                // Upload: arquivo recebido (e o seu checkpoint)
+    int end_sent;                  // Download: ENDs já enviados
+    int end_reply;                 // Upload: resposta dada ao END (1 ACK, -1 ERROR), 0 antes dele
+    int end_pending;               // Upload: END recebido, commit pendente ou em andamento
+    int end_seq;                   // Upload: seq do END (para a resposta)
+    int idle;                      // Upload: ociosa, encerrando depois do checkpoint final
+    int job;                       // Trabalho em andamento no pool (0: nenhum)
+    TransferStats *stats;          // Telemetria (NULL sem --stats)
+    long long last_activity;       // now_ns() do último pacote do cliente
+    long long deadline;            // Próximo prazo em now_ns() (posição heap_index no heap)
+    int heap_index;
+    struct Session *next;          // Encadeamento na tabela hash
+} Session;
+
+typedef struct Reactor {
+    int index;
+    int sockfd;
+    int done_fd[2];                // Pipe de conclusões do pool (ponteiros de Job)
+    Session *buckets[SESSION_BUCKETS];
+    Session **heap;                // Min-heap de sessões por deadline
+    int heap_len;
+    int heap_cap;
+    int active;
+    PacketBatch rx;                // Datagramas lidos por recvmmsg
+    int room;                      // Pacotes que ainda cabem no socket (janela anunciada)
+} Reactor;
+
+typedef struct Job {
+    int kind;
+    Reactor *r;                    // Laço dono da sessão (recebe a conclusão)
+    Session *s;
+    Packet req;                    // Aberturas: a requisição
+    Checkpoint ck;                 // JOB_CHECKPOINT: retrato do sink
+    int result;
+    struct Job *next;
+} Job;
+
+static pthread_mutex_t job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_cond = PTHREAD_COND_INITIALIZER;
+static Job *job_head = NULL, *job_tail = NULL;
+
+static unsigned session_hash(uint32_t id, const struct sockaddr_in *addr)
+{
+    uint32_t h = id ^ addr->sin_addr.s_addr ^ ((uint32_t)addr->sin_port << 16);
+    h ^= h >> 16;
+    h *= 0x45d9f3b;
+    h ^= h >> 16;
+    return h % SESSION_BUCKETS;
+}
+
+static Session *session_find(Reactor *r, uint32_t id, const struct sockaddr_in *addr)
+{
+    for (Session *s = r->buckets[session_hash(id, addr)]; s; s = s->next) {
+        if (s->id == id && s->addr.sin_port == addr->sin_port &&
+            s->addr.sin_addr.s_addr == addr->sin_addr.s_addr) {
+            return s;
+        }
+    }
+    return NULL;
+}
+
+// Heap de prazos: cada sessão guarda sua posição para reagendar em O(log n)
+static void heap_swap(Reactor *r, int i, int j)
+{
+    Session *tmp = r->heap[i];
+    r->heap[i] = r->heap[j];
+    r->heap[j] = tmp;
+    r->heap[i]->heap_index = i;
+    r->heap[j]->heap_index = j;
+}
+
+static void heap_up(Reactor *r, int i)
+{
+    while (i > 0 && r->heap[(i - 1) / 2]->deadline > r->heap[i]->deadline) {
+        heap_swap(r, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+static void heap_down(Reactor *r, int i)
+{
+    while (1) {
+        int smallest = i;
+        int left = 2 * i + 1, right = 2 * i + 2;
+        if (left < r->heap_len && r->heap[left]->deadline < r->heap[smallest]->deadline) smallest = left;
+        if (right < r->heap_len && r->heap[right]->deadline < r->heap[smallest]->deadline) smallest = right;
+        if (smallest == i) return;
+        heap_swap(r, i, smallest);
+        i = smallest;
+    }
+}
+
+// Agenda (ou reagenda) o prazo da sessão
+static void timer_set(Reactor *r, Session *s, long long deadline)
+{
+    s->deadline = deadline;
+    if (s->heap_index < 0) {
+        if (r->heap_len == r->heap_cap) {
+            int cap = r->heap_cap ? 2 * r->heap_cap : 64;
+            Session **heap = (Session**)realloc(r->heap, cap * sizeof(Session*));
+            if (!heap) die("realloc");
+            r->heap = heap;
+            r->heap_cap = cap;
+        }
+        s->heap_index = r->heap_len;
+        r->heap[r->heap_len++] = s;
+    }
+    heap_up(r, s->heap_index);
+    heap_down(r, s->heap_index);
+}
+
+static void timer_remove(Reactor *r, Session *s)
+{
+    int i = s->heap_index;
+    if (i < 0) return;
+    r->heap_len--;
+    if (i != r->heap_len) {
+        Session *moved = r->heap[r->heap_len];
+        r->heap[i] = moved;
+        moved->heap_index = i;
+        heap_up(r, i);
+        heap_down(r, moved->heap_index);
+    }
+    s->heap_index = -1;
+}
+
+static Session *session_new(Reactor *r, const Packet *req, const struct sockaddr_in *addr,
+                            socklen_t addr_len)
+{
+    Session *s = (Session*)calloc(1, sizeof(Session));
+    if (!s) return NULL;
+    s->id = req->session_id;
+    s->addr = *addr;
+    s->addr_len = addr_len;
+    // Assinatura é servida como download e o delta recebido como upload
+    s->type = req->type == PKT_SIGNATURE_REQUEST ? PKT_DOWNLOAD_REQUEST :
+              req->type == PKT_DELTA_REQUEST ? PKT_UPLOAD_REQUEST : req->type;
+    s->delta = req->type == PKT_DELTA_REQUEST;
+    s->fd = -1;
+    memcpy(s->filename, req->filename, sizeof(s->filename));
+    s->last_activity = now_ns();
+    s->heap_index = -1;
+    
+    unsigned bucket = session_hash(s->id, addr);
+    s->next = r->buckets[bucket];
+    r->buckets[bucket] = s;
+    r->active++;
+    return s;
+}
+
+static void session_close(Reactor *r, Session *s)
+{
+    timer_remove(r, s);
+    telemetry_end(s->stats);
+    
+    Session **link = &r->buckets[session_hash(s->id, &s->addr)];
+    while (*link != s) link = &(*link)->next;
+    *link = s->next;
+    
+    if (s->fd != -1) close(s->fd);
+    if (s->window) sender_destroy(s->window);
+    free(s->fec);
+    free(s);
+    r->active--;
+}
+
+// Entrega um trabalho ao pool; a sessão não é tocada pelo laço no que o
+// trabalho usa até a conclusão (job_done)
+static void job_submit(Reactor *r, Session *s, int kind, const Packet *req)
+{
+    Job *job = (Job*)calloc(1, sizeof(Job));
+    if (!job) die("calloc");
+    job->kind = kind;
+    job->r = r;
+    job->s = s;
+    if (req) job->req = *req;
+    if (kind == JOB_CHECKPOINT) {
+        sink_checkpoint(&s->sink, &job->ck);
+        s->sink.ckpt_base = s->sink.base;
+        s->sink.ckpt_due = 0;
+    } else {
+        // Sessão parada: sem prazos até a conclusão
+        timer_remove(r, s);
+    }
+    s->job = kind;
+    
+    pthread_mutex_lock(&job_lock);
+    if (job_tail) job_tail->next = job; else job_head = job;
+    job_tail = job;
+    pthread_cond_signal(&job_cond);
+    pthread_mutex_unlock(&job_lock);
+}
+
+// Abertura de um download no pool: arquivo (ou assinatura), conferência da
+// retomada, janela e a primeira leitura. 0 com s->fd e s->window prontos;
+// -1 arquivo não encontrado, -2 checkpoint divergente, -3 sem memória
+static int job_download_open(Job *job)
+{
+    Session *s = job->s;
+    int fd = download_open(&job->req);
+    if (fd == -1) return -1;
+    
+    struct stat st;
+    fstat(fd, &st);
+    int total_packets = (int)((st.st_size + BUFLEN - 1) / BUFLEN);
+    int first, end;
+    request_range(&job->req, total_packets, &first, &end);
+    
+    if (resume_verify(&job->req, fd, first) == -1) {
+        close(fd);
+        return -2;
+    }
+    
+    SlidingWindow *window = window_create(NULL, job->r->sockfd, &s->addr, s->addr_len, s->id, fd, first, end,
+                                          job->req.type == PKT_DOWNLOAD_REQUEST ? job->req.filename : NULL);
+    if (!window) {
+        close(fd);
+        return -3;
+    }
+    s->stats = window->stats = telemetry_begin(transfer_kind(job->req.type), s->id, s->filename, &s->addr);
+    fill_window(window);
+    s->fd = fd;
+    s->window = window;
+    return 0;
+}
+
+static void job_run(Job *job)
+{
+    Session *s = job->s;
+    switch (job->kind) {
+    case JOB_DOWNLOAD_OPEN:
+        job->result = job_download_open(job);
+        break;
+    case JOB_UPLOAD_OPEN:
+        s->fd = upload_open(&job->req, s->path, &s->sink, "[UPLOAD] ");
+        if (s->fd != -1) {
+            s->stats = s->sink.stats = telemetry_begin(transfer_kind(job->req.type), s->id,
+                                                       s->filename, &s->addr);
+        }
+        break;
+    case JOB_CHECKPOINT:
+        checkpoint_save(s->path, s->fd, &job->ck);
+        break;
+    case JOB_COMMIT:
+        job->result = s->delta && delta_commit(s->filename, s->fd, s->path, "[UPLOAD] ") == -1 ? -1 : 1;
+        sink_finish(&s->sink, 1);
+        close(s->fd);
+        s->fd = -1;
+        break;
+    case JOB_ABORT:
+        sink_finish(&s->sink, 0);
+        break;
+    }
+}
+
+static void* job_worker(void *arg)
+{
+    (void)arg;
+    while (1) {
+        pthread_mutex_lock(&job_lock);
+        while (!job_head) pthread_cond_wait(&job_cond, &job_lock);
+        Job *job = job_head;
+        job_head = job->next;
+        if (!job_head) job_tail = NULL;
+        pthread_mutex_unlock(&job_lock);
+        
+        job_run(job);
+        // Conclusão para o laço da sessão (escrita de um ponteiro: atômica no pipe)
+        if (write(job->r->done_fd[1], &job, sizeof(job)) != (ssize_t)sizeof(job)) die("write");
+    }
+    return NULL;
+}
+
+static void download_send_end(Reactor *r, Session *s)
+{
+    Packet end_pkt;
+    memset(&end_pkt, 0, sizeof(Packet));
+    end_pkt.type = PKT_END;
+    end_pkt.session_id = s->id;
+    end_pkt.seq_num = s->window->total_packets;
+    
+    // Um END por RTO, com backoff a partir do segundo
+    if (s->end_sent++ > 0) rtt_on_timeout(&s->window->rtt);
+    send_packet(r->sockfd, &end_pkt, &s->addr, s->addr_len);
+    long long deadline = now_ns() + rtt_rto_ns(&s->window->rtt);
+    if (deadline > s->last_activity + SESSION_IDLE_NS + 1) {
+        deadline = s->last_activity + SESSION_IDLE_NS + 1;
+    }
+    timer_set(r, s, deadline);
+}
+
+// Retransmite o que já se sabe perdido e reprograma o prazo da sessão
+// (RACK, probe de cauda ou RTO), limitado pela ociosidade do cliente
+static void download_rearm(Reactor *r, Session *s)
+{
+    long long deadline = sender_check_timeouts(s->window, now_ns());
+    if (deadline > s->last_activity + SESSION_IDLE_NS + 1) {
+        deadline = s->last_activity + SESSION_IDLE_NS + 1;
+    }
+    timer_set(r, s, deadline);
+}
+
+// Avança um download: envia o que a cwnd e o pacer permitem, lê à frente e
+// antecipa o prazo da sessão para o probe de cauda dos pacotes novos ou para
+// a próxima ficha do pacer. No reactor a janela pertence a um único laço,
+// então as funções sender_* dispensam o lock.
+static void download_pump(Reactor *r, Session *s)
+{
+    SlidingWindow *window = s->window;
+    
+    fill_window(window);
+    if (window->base >= window->total_packets) {
+        if (s->end_sent == 0) {
+            printf("[REACTOR %d] Sessão %08x: enviando END (%d pacotes)\n", 
+                   r->index, s->id, window->total_packets);
+            download_send_end(r, s);
+        }
+        return;
+    }
+    
+    // Envia antes da leitura antecipada: na requisição, a primeira janela é a resposta
+    int sent = sender_send_window(window);
+    fill_ring(window);
+    long long now = now_ns();
+    long long deadline = -1;
+    if (sent > 0) deadline = lr_probe_deadline(&window->lr, now, rtt_srtt_ns(&window->rtt));
+    long long paced = sender_paced_until(window, now);
+    if (paced > 0 && (deadline < 0 || paced < deadline)) deadline = paced;
+    if (deadline >= 0 && (s->heap_index < 0 || deadline < s->deadline)) timer_set(r, s, deadline);
+}
+
+// Requisição de download: a sessão nasce parada e a abertura vai para o pool
+static void reactor_start_download(Reactor *r, const Packet *req, const struct sockaddr_in *addr,
+                                   socklen_t addr_len)
+{
+    Session *s = session_new(r, req, addr, addr_len);
+    if (!s) {
+        printf("[REACTOR %d] Erro ao alocar memória\n", r->index);
+        return;
+    }
+    job_submit(r, s, JOB_DOWNLOAD_OPEN, req);
+}
+
+// Abertura concluída: a primeira janela é a resposta à requisição
+static void download_opened(Reactor *r, Session *s, int result)
+{
+    if (result < 0) {
+        if (result == -1) {
+            printf("[REACTOR %d] Erro ao abrir arquivo: %s\n", r->index, s->filename);
+            send_error(r->sockfd, s->id, "Arquivo nao encontrado", &s->addr, s->addr_len);
+        } else if (result == -2) {
+            printf("[REACTOR %d] ❌ Checkpoint do cliente não confere: %s\n", r->index, s->filename);
+            send_error(r->sockfd, s->id, RESUME_MISMATCH_MSG, &s->addr, s->addr_len);
+        } else {
+            printf("[REACTOR %d] Erro ao alocar memória\n", r->index);
+        }
+        session_close(r, s);
+        return;
+    }
+    
+    SlidingWindow *window = s->window;
+    download_pump(r, s);
+    
+    printf("[REACTOR %d] DOWNLOAD '%s' sessão %08x de %s:%d (pacotes %d a %d, %d sessões)\n", 
+           r->index, s->filename, s->id, inet_ntoa(s->addr.sin_addr), ntohs(s->addr.sin_port),
+           window->base, window->total_packets - 1, r->active);
+    char tag[24];
+    snprintf(tag, sizeof(tag), "[REACTOR %d] ", r->index);
+    cache_log(tag, window);
+}
+
+static void reactor_start_upload(Reactor *r, const Packet *req, const struct sockaddr_in *addr,
+                                 socklen_t addr_len)
+{
+    Session *s = session_new(r, req, addr, addr_len);
+    if (!s) {
+        printf("[REACTOR %d] Erro ao alocar memória\n", r->index);
+        return;
+    }
+    upload_path(req, s->path, sizeof(s->path));
+    job_submit(r, s, JOB_UPLOAD_OPEN, req);
+}
+
+static void upload_opened(Reactor *r, Session *s)
+{
+    if (s->fd == -1) {
+        printf("[REACTOR %d] Erro ao criar arquivo: %s\n", r->index, s->path);
+        send_error(r->sockfd, s->id, "Erro ao criar arquivo no servidor", &s->addr, s->addr_len);
+        session_close(r, s);
+        return;
+    }
+    s->sink.ckpt_defer = 1;
+    
+    // ACK da requisição: o cliente passa a enviar os dados para esta mesma porta
+    send_upload_ack(r->sockfd, s->id, &s->sink, &s->addr, s->addr_len);
+    timer_set(r, s, now_ns() + SESSION_IDLE_NS);
+    
+    printf("[REACTOR %d] UPLOAD '%s' sessão %08x de %s:%d (%d sessões)\n", 
+           r->index, s->filename, s->id, inet_ntoa(s->addr.sin_addr), ntohs(s->addr.sin_port),
+           r->active);
+}
+
+// Commit concluído (delta aplicado, checkpoint removido): responde ao END
+static void upload_committed(Reactor *r, Session *s, int result)
+{
+    s->end_reply = result;
+    send_end_reply(r->sockfd, s->id, s->end_reply, s->end_seq, s->sink.base,
+                   fec_recovered(s->fec), &s->addr, s->addr_len);
+    printf("[REACTOR %d] ✓ Upload concluído: received_%s (sessão %08x)\n", 
+           r->index, s->filename, s->id);
+    fec_decoder_finish(s->fec, "[UPLOAD] ");
+    s->fec = NULL;
+    
+    // A sessão fica mais END_LINGER_MS para responder ENDs repetidos
+    timer_set(r, s, now_ns() + END_LINGER_NS);
+}
+
+static void job_done(Reactor *r, Job *job)
+{
+    Session *s = job->s;
+    s->job = 0;
+    switch (job->kind) {
+    case JOB_DOWNLOAD_OPEN:
+        download_opened(r, s, job->result);
+        break;
+    case JOB_UPLOAD_OPEN:
+        upload_opened(r, s);
+        break;
+    case JOB_CHECKPOINT:
+        // END ou ociosidade chegaram durante a gravação
+        if (s->end_pending) {
+            job_submit(r, s, JOB_COMMIT, NULL);
+        } else if (s->idle) {
+            job_submit(r, s, JOB_ABORT, NULL);
+        }
+        break;
+    case JOB_COMMIT:
+        upload_committed(r, s, job->result);
+        break;
+    case JOB_ABORT:
+        session_close(r, s);
+        break;
+    }
+}
+
+// Conclusões do pool para este laço
+static void reactor_jobs_done(Reactor *r)
+{
+    Job *job;
+    while (read(r->done_fd[0], &job, sizeof(job)) == (ssize_t)sizeof(job)) {
+        job_done(r, job);
+        free(job);
+    }
+}
+
+static void download_on_packet(Reactor *r, Session *s, const Packet *pkt)
+{
+    if (pkt->type != PKT_ACK) return;
+    
+    if (s->end_sent > 0) {
+        // ACK do END: o cliente terminou, não é preciso repetir o END
+        if (pkt->seq_num >= s->window->total_packets) {
+            printf("[REACTOR %d] ✓ Download concluído: %s (sessão %08x)\n", 
+                   r->index, s->filename, s->id);
+            fec_encoder_report("[DOWNLOAD] ", s->window->fec);
+            session_close(r, s);
+        }
+        return;
+    }
+    
+    if (sender_on_ack(s->window, pkt) > 0) download_rearm(r, s);
+    download_pump(r, s);
+}
+
+static void upload_on_packet(Reactor *r, Session *s, const Packet *pkt)
+{
+    if (s->end_reply) {
+        // Já concluído: END repetido porque a resposta se perdeu
+        if (pkt->type == PKT_END) {
+            send_end_reply(r->sockfd, s->id, s->end_reply, pkt->seq_num, s->sink.base, 0,
+                           &s->addr, s->addr_len);
+            timer_set(r, s, s->last_activity + END_LINGER_NS);
+        }
+        return;
+    }
+    
+    // Commit esperando o checkpoint em andamento: o resto chega atrasado
+    if (s->end_pending) return;
+    
+    if (pkt->type == PKT_UPLOAD_REQUEST) {
+        // Requisição repetida: o ACK inicial se perdeu
+        send_upload_ack(r->sockfd, s->id, &s->sink, &s->addr, s->addr_len);
+    } else if (pkt->type == PKT_END) {
+        // Delta e remoção do checkpoint no pool; a resposta sai na conclusão
+        s->end_pending = 1;
+        s->end_seq = pkt->seq_num;
+        if (!s->job) job_submit(r, s, JOB_COMMIT, NULL);
+        return;
+    } else if (pkt->type == PKT_DATA && sink_on_data(&s->sink, pkt)) {
+        send_ack(r->sockfd, s->id, pkt->seq_num, s->sink.base, sink_sack_bitmap(&s->sink), 
+                 sink_rwnd(&s->sink, r->room), fec_recovered(s->fec), &s->addr, s->addr_len);
+        if (s->sink.ckpt_due && !s->job) job_submit(r, s, JOB_CHECKPOINT, NULL);
+    } else if (pkt->type == PKT_FEC && fec_on_parity(&s->fec, &s->sink, pkt) > 0) {
+        send_ack(r->sockfd, s->id, pkt->seq_num + pkt->fec_k - 1, s->sink.base,
+                 sink_sack_bitmap(&s->sink), sink_rwnd(&s->sink, r->room), fec_recovered(s->fec),
+                 &s->addr, s->addr_len);
+    }
+    timer_set(r, s, s->last_activity + SESSION_IDLE_NS);
+}
+
+// Prazo vencido: retransmissão, próximo END, fim da espera depois do END de
+// um upload ou sessão ociosa
+static void session_on_timer(Reactor *r, Session *s, long long now)
+{
+    if (s->end_reply) {
+        session_close(r, s);
+        return;
+    }
+    
+    if (now - s->last_activity > SESSION_IDLE_NS) {
+        printf("[REACTOR %d] ⏰ Sessão %08x ociosa, encerrando (%s)\n", r->index, s->id, s->filename);
+        if (s->type == PKT_UPLOAD_REQUEST) {
+            // Checkpoint final no pool; a sessão fecha na conclusão
+            s->idle = 1;
+            if (!s->job) job_submit(r, s, JOB_ABORT, NULL);
+            else timer_remove(r, s);
+            return;
+        }
+        session_close(r, s);
+        return;
+    }
+    
+    if (s->type == PKT_UPLOAD_REQUEST) {
+        timer_set(r, s, s->last_activity + SESSION_IDLE_NS + 1);
+        return;
+    }
+    
+    if (s->end_sent > 0) {
+        if (s->end_sent < END_MAX_TRIES) {
+            download_send_end(r, s);
+        } else {
+            printf("[REACTOR %d] ⚠️  Download sem confirmação do END: %s (sessão %08x)\n", 
+                   r->index, s->filename, s->id);
+            fec_encoder_report("[DOWNLOAD] ", s->window->fec);
+            session_close(r, s);
+        }
+        return;
+    }
+    
+    // Retransmissões vencidas e, se o prazo era do pacer, os próximos envios
+    download_rearm(r, s);
+    download_pump(r, s);
+}
+
+static void reactor_dispatch(Reactor *r, const Packet *pkt, const struct sockaddr_in *addr,
+                             socklen_t addr_len)
+{
+    Session *s = session_find(r, pkt->session_id, addr);
+    if (!s) {
+        if (pkt->type == PKT_DOWNLOAD_REQUEST || pkt->type == PKT_SIGNATURE_REQUEST) {
+            reactor_start_download(r, pkt, addr, addr_len);
+        } else if (pkt->type == PKT_UPLOAD_REQUEST || pkt->type == PKT_DELTA_REQUEST) {
+            reactor_start_upload(r, pkt, addr, addr_len);
+        } else if (pkt->type == PKT_STAT_REQUEST) {
+            send_stat(r->sockfd, pkt, addr, addr_len);
+        }
+        // Demais tipos sem sessão: pacote atrasado de transferência já encerrada
+        return;
+    }
+    
+    // Parada à espera do pool: requisições e ENDs repetidos são respondidos na conclusão
+    if (s->idle || (s->job && s->job != JOB_CHECKPOINT)) return;
+    
+    s->last_activity = now_ns();
+    if (s->type == PKT_DOWNLOAD_REQUEST) {
+        download_on_packet(r, s, pkt);
+    } else {
+        upload_on_packet(r, s, pkt);
+    }
+}
+
+// epoll com prazo absoluto em now_ns() (-1: sem prazo). Sem epoll_pwait2
+// (glibc < 2.35 ou kernel < 5.11) o timeout é arredondado para cima em ms
+static int reactor_wait(int epfd, struct epoll_event *events, int max, long long deadline)
+{
+    long long wait = deadline < 0 ? -1 : deadline - now_ns();
+    if (deadline >= 0 && wait < 0) wait = 0;
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+    struct timespec ts;
+    ns_to_timespec(wait, &ts);
+    int n = epoll_pwait2(epfd, events, max, wait < 0 ? NULL : &ts, NULL);
+    if (n != -1 || errno != ENOSYS) return n;
+#endif
+    return epoll_wait(epfd, events, max, wait < 0 ? -1 : (int)((wait + 999999) / 1000000));
+}
+
+static void* reactor_loop(void *arg)
+{
+    Reactor *r = (Reactor*)arg;
+    
+    int epfd = epoll_create1(0);
+    if (epfd == -1) die("epoll_create1");
+    
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = r->sockfd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, r->sockfd, &ev) == -1) die("epoll_ctl");
+    ev.data.fd = r->done_fd[0];
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, r->done_fd[0], &ev) == -1) die("epoll_ctl");
+    
+    while (1) {
+        // Dorme até chegar um datagrama ou vencer o prazo mais próximo
+        struct epoll_event events[2];
+        int n = reactor_wait(epfd, events, 2, r->heap_len > 0 ? r->heap[0]->deadline : -1);
+        if (n == -1 && errno != EINTR) die("epoll_pwait2");
+        
+        int readable = 0;
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == r->done_fd[0]) reactor_jobs_done(r);
+            else readable = 1;
+        }
+        
+        // Socket não bloqueante: um recvmmsg traz até IO_BATCH datagramas
+        // e os timers vencidos são atendidos entre um lote e outro
+        int count = readable ? batch_recv(r->sockfd, &r->rx) : 0;
+        if (count > 0) r->room = socket_room(r->sockfd);
+        for (int i = 0; i < count; i++) {
+            Packet pkt;
+            if (batch_packet(&r->rx, i, &pkt) == -1) continue;
+            reactor_dispatch(r, &pkt, &r->rx.addrs[i], r->rx.addr_lens[i]);
+        }
+        
+        long long now = now_ns();
+        while (r->heap_len > 0 && r->heap[0]->deadline <= now) {
+            session_on_timer(r, r->heap[0], now);
+        }
+    }
+    return NULL;
+}
+
+// Socket de um laço: todos compartilham a porta PORT via SO_REUSEPORT
+static int reactor_socket()
+{
+    int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == -1) die("socket");
+    
+    int one = 1;
+    if (setsockopt(s, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1) die("SO_REUSEPORT");
+    
+    // Buffers maiores: um único socket atende todas as sessões do laço
+    int bufsize = REACTOR_SOCKBUF;
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    setsockopt(s, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+    
+    struct sockaddr_in si_me;
+    memset(&si_me, 0, sizeof(si_me));
+    si_me.sin_family = AF_INET;
+    si_me.sin_port = htons(PORT);
+    si_me.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(s, (struct sockaddr*)&si_me, sizeof(si_me)) == -1) die("bind");
+    return s;
+}
+
+// Cria os laços (um socket cada) e bloqueia atendendo as sessões
+static void run_reactor(int loops)
+{
+    Reactor **reactors = (Reactor**)calloc(loops, sizeof(Reactor*));
+    pthread_t *threads = (pthread_t*)calloc(loops, sizeof(pthread_t));
+    if (!reactors || !threads) die("calloc");
+    
+    for (int i = 0; i < loops; i++) {
+        reactors[i] = (Reactor*)calloc(1, sizeof(Reactor));
+        if (!reactors[i]) die("calloc");
+        reactors[i]->index = i;
+        reactors[i]->sockfd = reactor_socket();
+        if (pipe(reactors[i]->done_fd) == -1) die("pipe");
+        fcntl(reactors[i]->done_fd[0], F_SETFL, fcntl(reactors[i]->done_fd[0], F_GETFL) | O_NONBLOCK);
+        if (io_offload) batch_enable_gro(reactors[i]->sockfd, &reactors[i]->rx);
+    }
+    
+    printf("✓ Servidor rodando na porta %d\n\n", PORT);
+    print_addresses();
+    printf("Aguardando requisições...\n\n");
+    
+    for (int i = 0; i < REACTOR_WORKERS; i++) {
+        pthread_t worker;
+        pthread_create(&worker, NULL, job_worker, NULL);
+        pthread_detach(worker);
+    }
+    for (int i = 0; i < loops; i++) {
+        pthread_create(&threads[i], NULL, reactor_loop, reactors[i]);
+    }
+    for (int i = 0; i < loops; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    struct sockaddr_in si_me, si_other;
+    int s;
+    socklen_t slen = sizeof(si_other);
+    Packet pkt;
+    
+    int reactor_loops = 0;
+    
+    // Opções: --cc reno|cubic|delay, --reactor [laços], --gso, --rate <Mbit/s>,
+    // --cache <MB>, --fec, --stats <arquivo>, --verbose
+    const char *stats_path = NULL;
+    int verbose = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--cc") == 0 && i + 1 < argc) {
+            cc_ops = cc_find(argv[++i]);
+            if (!cc_ops) {
+                fprintf(stderr, "Algoritmo desconhecido: %s (use reno, cubic ou delay)\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--reactor") == 0) {
+            // Um laço por núcleo, a menos que o número seja informado
+            reactor_loops = (int)sysconf(_SC_NPROCESSORS_ONLN);
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) reactor_loops = atoi(argv[++i]);
+            if (reactor_loops < 1) reactor_loops = 1;
+        } else if (strcmp(argv[i], "--gso") == 0) {
+            io_offload = 1;
+        } else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            pacing_max_rate = atof(argv[++i]) * 1e6 / 8;
+            if (pacing_max_rate <= 0) {
+                fprintf(stderr, "Taxa inválida: %s (Mbit/s por sessão)\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc) {
+            // Limite do cache; 0 (padrão) desliga
+            long long mb = atoll(argv[++i]);
+            cache_limit = mb > 0 ? mb << 20 : 0;
+        } else if (strcmp(argv[i], "--fec") == 0) {
+            fec_enabled = 1;
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            stats_path = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = 1;
+        } else {
+            fprintf(stderr, "Uso: %s [--cc reno|cubic|delay] [--reactor [laços]] [--gso] [--rate <Mbit/s>] "
+                    "[--cache <MB>] [--fec] [--stats <arquivo>] [--verbose]\n", argv[0]);
+            exit(1);
+        }
+    }
+#ifndef __linux__
+    if (reactor_loops > 0) {
+        fprintf(stderr, "Modo reactor requer epoll (Linux); usando uma thread por transferência\n");
+        reactor_loops = 0;
+    }
+#endif
+    
+    printf("═══════════════════════════════════════════\n");
+    printf("   SERVIDOR FTP UDP - SELECTIVE REPEAT\n");
+    printf("   🚀 Janela dinâmica: até %d pacotes (%s)\n", MAX_WINDOW, cc_ops->name);
+    printf("   🔄 Reenvio seletivo de pacotes perdidos\n");
+    if (io_offload) {
+        printf("   🧩 Offload UDP GSO/GRO (com fallback)\n");
+    }
+    if (reactor_loops > 0) {
+        printf("   ⚡ Reactor: %d laços epoll na porta %d\n", reactor_loops, PORT);
+    }
+    if (pacing_max_rate > 0) {
+        printf("   🚦 Pacing limitado a %.1f Mbit/s por sessão\n", pacing_max_rate * 8 / 1e6);
+    }
+    if (cache_limit > 0) {
+        printf("   🗃️  Cache de arquivos: até %lld MB\n", cache_limit >> 20);
+    }
+    if (fec_enabled) {
+        printf("   🛡️  FEC adaptativa nos downloads (blocos de %d, até %d paridades)\n",
+               FEC_BLOCK, FEC_MAX_M);
+    }
+    if (stats_path) {
+        printf("   📈 Telemetria: %s (a cada %d ms)\n", stats_path, TELEMETRY_INTERVAL_MS);
+    }
+    printf("═══════════════════════════════════════════\n\n");
+    
+    telemetry_extra = cache_metrics;
+    if (stats_path) telemetry_start(stats_path, "sliding-window");
+    
+    // Modo de vazão: log por pacote só com --verbose
+    log_start(verbose ? LOG_PACKET : LOG_INFO);
+    
+#ifdef __linux__
+    if (reactor_loops > 0) {
+        run_reactor(reactor_loops);
+        return 0;
+    }
+#endif
+    
+    // Criar socket UDP principal (apenas para receber requisições)
+    if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
+        die("socket");
+    }
+    
+    memset((char *)&si_me, 0, sizeof(si_me));
+    
+    si_me.sin_family = AF_INET;
+    si_me.sin_port = htons(PORT);
+    si_me.sin_addr.s_addr = htonl(INADDR_ANY);
+    
+    // Bind
+    if (bind(s, (struct sockaddr*)&si_me, sizeof(si_me)) == -1) {
+        die("bind");
+    }
+    
+    printf("✓ Servidor rodando na porta %d\n\n", PORT);
+    print_addresses();
     
     printf("Aguardando requisições...\n\n");
     
+    spare_refill();
+    
     // Loop principal
     while (1) {
         memset(&pkt, 0, sizeof(Packet));
         
         // Recebe requisição
-        int recv_len = recvfrom(s, &pkt, sizeof(Packet), 0, 
-                                (struct sockaddr*)&si_other, &slen);
+        int recv_len = recv_packet(s, &pkt, &si_other, &slen);
         
         if (recv_len <= 0) continue;
         
@@ -574,7 +1641,7 @@ int main(void)
                inet_ntoa(si_other.sin_addr), ntohs(si_other.sin_port));
         
         // Cria thread conforme o tipo de requisição
-        ThreadArgs *args = (ThreadArgs*)malloc(sizeof(ThreadArgs));
+        ThreadArgs *args = (ThreadArgs*)calloc(1, sizeof(ThreadArgs));
         args->client_addr = si_other;
         args->addr_len = slen;
         args->sockfd = s;
@@ -583,11 +1650,24 @@ int main(void)
         pthread_t thread_id;
         
         if (pkt.type == PKT_DOWNLOAD_REQUEST) {
+            // Nenhuma E/S de arquivo aqui: um open ou read que bloqueie
+            // (FIFO, disco frio, NFS) pararia as requisições de todos
+            download_dispatch(args);
             printf("Tipo: DOWNLOAD arquivo '%s'\n", pkt.filename);
-            pthread_create(&thread_id, NULL, thread_download, args);
         } else if (pkt.type == PKT_UPLOAD_REQUEST) {
             printf("Tipo: UPLOAD arquivo '%s'\n", pkt.filename);
             pthread_create(&thread_id, NULL, thread_upload, args);
+        } else if (pkt.type == PKT_SIGNATURE_REQUEST) {
+            download_dispatch(args);
+            printf("Tipo: ASSINATURA de 'received_%s' (upload por delta)\n", pkt.filename);
+        } else if (pkt.type == PKT_DELTA_REQUEST) {
+            printf("Tipo: DELTA do arquivo '%s'\n", pkt.filename);
+            pthread_create(&thread_id, NULL, thread_upload, args);
+        } else if (pkt.type == PKT_STAT_REQUEST) {
+            // Só o tamanho: responde daqui mesmo, sem thread
+            printf("Tipo: STAT arquivo '%s'\n", pkt.filename);
+            send_stat(s, &pkt, &si_other, slen);
+            free(args);
         } else if (pkt.type == PKT_DATA) {
             printf("Transmissao de Dados: %d\n", pkt.type);
             free(args);
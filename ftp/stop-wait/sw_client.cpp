@@ -1,8 +1,11 @@
 /*
     FTP Client com UDP - Stop and Wait
     Suporta upload e download de arquivos
-    - Checksum CRC32 para integridade
-    - Timeout adaptativo
+    - Checksum CRC32 para integridade (acelerado, ver ../checksum.h)
+    - Formato compacto no fio (ver ../protocol.h)
+    - Timeout adaptativo: RTT em ns com regra de Karn e RTO da RFC 6298 (ver ../rtt.h)
+    - Retomada: transferência interrompida continua do checkpoint (ver ../checkpoint.h)
+    - Log assíncrono por pacote (ver ../log.h)
 */
 #include <stdio.h>
 #include <string.h>
@@ -15,30 +18,16 @@
 #include <sys/time.h>
 #include <math.h>
 
-#define BUFLEN 1024
+#include "../protocol.h"
+#include "../checksum.h"
+#include "../checkpoint.h"
+#include "../log.h"
+#include "../rtt.h"
+
 #define PORT 9999
 #define INITIAL_TIMEOUT_SEC 5
 #define MAX_RETRIES 5
-#define ALPHA 0.125
-#define BETA 0.25
-
-// Tipos de pacotes
-#define PKT_UPLOAD_REQUEST 1
-#define PKT_DOWNLOAD_REQUEST 2
-#define PKT_DATA 3
-#define PKT_ACK 4
-#define PKT_END 5
-#define PKT_ERROR 6
-
-// Estrutura do pacote
-typedef struct {
-    int type;
-    int seq_num;
-    int data_len;
-    char filename[256];
-    char data[BUFLEN];
-    unsigned int checksum;
-} Packet;
+#define SW_RTO_MIN_NS 50000000LL  // RTO mínimo (50 ms)
 
 void die(const char *s)
 {
@@ -46,33 +35,11 @@ void die(const char *s)
     exit(1);
 }
 
-// Calcular CRC32
-unsigned int calculate_checksum(const char *data, int len)
-{
-    unsigned int crc = 0xFFFFFFFF;
-    for (int i = 0; i < len; i++) {
-        crc ^= (unsigned char)data[i];
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1)
-                crc = (crc >> 1) ^ 0xEDB88320;
-            else
-                crc >>= 1;
-        }
-    }
-    return ~crc;
-}
-
-// Obter timestamp
-long long get_timestamp_ms()
-{
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (long long)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
-}
-
 // Função para enviar pacote com retransmissão e timeout adaptativo
+// (reply, se não for NULL, recebe o ACK: o da requisição de upload traz o ponto de retomada)
 int send_packet_with_ack(int sockfd, Packet *pkt, struct sockaddr_in *addr, 
-                         socklen_t addr_len, double *estimated_rtt, double *dev_rtt)
+                         socklen_t addr_len, RttEstimator *rtt,
+                         Packet *reply)
 {
     Packet ack;
     int tentativa = 0;
@@ -80,54 +47,48 @@ int send_packet_with_ack(int sockfd, Packet *pkt, struct sockaddr_in *addr,
     // Calcular checksum
     pkt->checksum = calculate_checksum(pkt->data, pkt->data_len);
     
-    // Timeout adaptativo
-    int timeout_ms = (int)((*estimated_rtt + 4 * (*dev_rtt)) * 1000);
-    if (timeout_ms < 1000) timeout_ms = 1000;
-    if (timeout_ms > 10000) timeout_ms = 10000;
-    
-    struct timeval tv;
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    
     while (tentativa < MAX_RETRIES) {
-        long long send_time = get_timestamp_ms();
+        // Timeout adaptativo: RTO atual, já com o backoff dos timeouts anteriores
+        long long timeout_ns = rtt_rto_ns(rtt);
+        struct timeval tv;
+        tv.tv_sec = timeout_ns / 1000000000LL;
+        tv.tv_usec = (timeout_ns % 1000000000LL) / 1000;
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        
+        long long send_time = now_ns();
         
-        if (sendto(sockfd, pkt, sizeof(Packet), 0, (struct sockaddr*)addr, addr_len) == -1) {
+        if (send_packet(sockfd, pkt, addr, addr_len) == -1) {
             perror("sendto");
             return -1;
         }
         
-        printf("  Enviado seq=%d (tent. %d/%d, timeout=%dms)\n", 
-               pkt->seq_num, tentativa + 1, MAX_RETRIES, timeout_ms);
+        LOG(LOG_PACKET, "  Enviado seq=%d (tent. %d/%d, timeout=%.1fms)\n", 
+            pkt->seq_num, tentativa + 1, MAX_RETRIES, timeout_ns / 1e6);
         
         memset(&ack, 0, sizeof(Packet));
-        int recv_len = recvfrom(sockfd, &ack, sizeof(Packet), 0, 
-                               (struct sockaddr*)addr, &addr_len);
+        int recv_len = recv_packet(sockfd, &ack, addr, &addr_len);
         
         if (recv_len > 0 && ack.type == PKT_ACK && ack.seq_num == pkt->seq_num) {
-            long long recv_time = get_timestamp_ms();
-            double sample_rtt = (recv_time - send_time) / 1000.0;
+            long long sample_ns = now_ns() - send_time;
             
-            // Atualizar RTT
-            *dev_rtt = (1 - BETA) * (*dev_rtt) + BETA * fabs(sample_rtt - *estimated_rtt);
-            *estimated_rtt = (1 - ALPHA) * (*estimated_rtt) + ALPHA * sample_rtt;
+            // Atualizar RTT (regra de Karn: só sem retransmissão)
+            if (tentativa == 0) rtt_sample(rtt, sample_ns);
             
-            printf("  ✓ ACK recebido seq=%d (RTT=%.3fs, Est=%.3fs)\n", 
-                   pkt->seq_num, sample_rtt, *estimated_rtt);
+            LOG(LOG_PACKET, "  ✓ ACK recebido seq=%d (RTT=%.6fs, Est=%.6fs)\n", 
+                pkt->seq_num, sample_ns / 1e9, rtt_srtt_s(rtt));
+            if (reply) *reply = ack;
             return 0;
         }
         
         if (recv_len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            printf("   Timeout aguardando ACK seq=%d\n", pkt->seq_num);
-            timeout_ms = (int)(timeout_ms * 1.5);
-            if (timeout_ms > 10000) timeout_ms = 10000;
+            LOG(LOG_WARN, "   Timeout aguardando ACK seq=%d\n", pkt->seq_num);
+            rtt_on_timeout(rtt);
         }
         
         tentativa++;
     }
     
-    printf("  Falha após %d tentativas para seq=%d\n", MAX_RETRIES, pkt->seq_num);
+    LOG(LOG_ERROR, "  Falha após %d tentativas para seq=%d\n", MAX_RETRIES, pkt->seq_num);
     return -1;
 }
 
@@ -138,8 +99,8 @@ void send_ack(int sockfd, int seq_num, struct sockaddr_in *addr, socklen_t addr_
     ack.type = PKT_ACK;
     ack.seq_num = seq_num;
     
-    sendto(sockfd, &ack, sizeof(Packet), 0, (struct sockaddr*)addr, addr_len);
-    printf("  ACK enviado para seq=%d\n", seq_num);
+    send_packet(sockfd, &ack, addr, addr_len);
+    LOG(LOG_PACKET, "  ACK enviado para seq=%d\n", seq_num);
 }
 
 // Upload sem bug de leitura
@@ -160,23 +121,44 @@ void upload_file(int sockfd, const char *filename, struct sockaddr_in *server_ad
     memset(&pkt, 0, sizeof(Packet));
     pkt.type = PKT_UPLOAD_REQUEST;
     pkt.seq_num = 0;
+    pkt.resume = 1;
     strncpy(pkt.filename, filename, sizeof(pkt.filename) - 1);
     
-    double estimated_rtt = 1.0;
-    double dev_rtt = 0.5;
+    RttEstimator rtt;
+    rtt_init(&rtt, SW_RTO_MIN_NS);
+    Packet reply;
     
     printf("Enviando requisição de upload...\n");
     if (send_packet_with_ack(sockfd, &pkt, server_addr, addr_len, 
-                            &estimated_rtt, &dev_rtt) == -1) {
+                            &rtt, &reply) == -1) {
         printf(" Falha ao enviar requisição\n");
         close(fd);
         return;
     }
     
-    // Enviar arquivo sem bug
+    // Retomada: o servidor devolve no ACK o que já tem (cum_ack) e o hash do
+    // prefixo, que precisa ser igual ao do arquivo local
     int seq_num = 0;
     int bytes_read;
     
+    if (reply.cum_ack > 0) {
+        uint32_t hash;
+        if (resume_hash_file(fd, reply.cum_ack, &hash) == 0 && hash == reply.checksum) {
+            seq_num = reply.cum_ack;
+            lseek(fd, (off_t)seq_num * BUFLEN, SEEK_SET);
+            printf("↻ Retomando do pacote %d (já recebidos pelo servidor)\n", seq_num);
+        } else {
+            printf("↻ Checkpoint do servidor não confere com o arquivo local, recomeçando do zero\n");
+            pkt.resume = 0;
+            if (send_packet_with_ack(sockfd, &pkt, server_addr, addr_len, 
+                                    &rtt, NULL) == -1) {
+                printf(" Falha ao enviar requisição\n");
+                close(fd);
+                return;
+            }
+        }
+    }
+    
     while (1) {
         memset(&pkt, 0, sizeof(Packet));
         
@@ -188,10 +170,10 @@ void upload_file(int sockfd, const char *filename, struct sockaddr_in *server_ad
         pkt.seq_num = seq_num;
         pkt.data_len = bytes_read;
         
-        printf("Enviando pacote %d (%d bytes)\n", seq_num, bytes_read);
+        LOG(LOG_PACKET, "Enviando pacote %d (%d bytes)\n", seq_num, bytes_read);
         
         if (send_packet_with_ack(sockfd, &pkt, server_addr, addr_len,
-                                &estimated_rtt, &dev_rtt) == -1) {
+                                &rtt, NULL) == -1) {
             printf(" Falha ao enviar pacote %d\n", seq_num);
             close(fd);
             return;
@@ -208,8 +190,9 @@ void upload_file(int sockfd, const char *filename, struct sockaddr_in *server_ad
     pkt.seq_num = seq_num;
     
     printf("Enviando pacote END...\n");
-    send_packet_with_ack(sockfd, &pkt, server_addr, addr_len, &estimated_rtt, &dev_rtt);
+    send_packet_with_ack(sockfd, &pkt, server_addr, addr_len, &rtt, NULL);
     
+    log_flush();
     printf("\n✓ Upload concluído! (%d pacotes enviados)\n", seq_num);
     printf("═══════════════════════════════════════════\n\n");
 }
@@ -221,28 +204,47 @@ void download_file(int sockfd, const char *filename, struct sockaddr_in *server_
     printf("DOWNLOAD: %s\n", filename);
     printf("═══════════════════════════════════════════\n");
     
-    Packet pkt;
-    memset(&pkt, 0, sizeof(Packet));
-    pkt.type = PKT_DOWNLOAD_REQUEST;
-    pkt.seq_num = 0;
-    strncpy(pkt.filename, filename, sizeof(pkt.filename) - 1);
-    
-    printf("Enviando requisição de download...\n");
-    if (sendto(sockfd, &pkt, sizeof(Packet), 0, (struct sockaddr*)server_addr, addr_len) == -1) {
-        printf(" Erro ao enviar requisição\n");
-        return;
-    }
-    
     char download_filename[300];
     snprintf(download_filename, sizeof(download_filename), "downloaded_%s", filename);
     
-    int fd = creat(download_filename, 0666);
+    // Checkpoint de uma tentativa anterior: mantém o arquivo parcial e continua dali
+    Checkpoint ck;
+    int resume = checkpoint_load(download_filename, &ck) == 0;
+    int fd = resume ? open(download_filename, O_WRONLY) : creat(download_filename, 0666);
     if (fd == -1) {
         printf(" Erro ao criar arquivo: %s\n", download_filename);
         return;
     }
     
     int expected_seq = 0;
+    uint32_t prefix_hash = resume_hash_init();
+    if (resume) {
+        expected_seq = ck.base;
+        prefix_hash = ck.prefix_hash;
+        lseek(fd, (off_t)expected_seq * BUFLEN, SEEK_SET);
+        printf("↻ Retomando do pacote %d (checkpoint de tentativa anterior)\n", expected_seq);
+    }
+    int checkpoint_seq = expected_seq;
+    int completed = 0;
+    
+    // A requisição leva o ponto de retomada e o hash do que já foi recebido
+    Packet req;
+    memset(&req, 0, sizeof(Packet));
+    req.type = PKT_DOWNLOAD_REQUEST;
+    req.seq_num = 0;
+    req.range_first = expected_seq;
+    req.resume = resume;
+    req.resume_hash = prefix_hash;
+    strncpy(req.filename, filename, sizeof(req.filename) - 1);
+    
+    printf("Enviando requisição de download...\n");
+    if (send_packet(sockfd, &req, server_addr, addr_len) == -1) {
+        printf(" Erro ao enviar requisição\n");
+        close(fd);
+        return;
+    }
+    
+    Packet pkt;
     
     struct timeval tv;
     tv.tv_sec = INITIAL_TIMEOUT_SEC * 2;
@@ -257,8 +259,7 @@ void download_file(int sockfd, const char *filename, struct sockaddr_in *server_
         memset(&pkt, 0, sizeof(Packet));
         
         // Recebe de qualquer porta (não apenas 9999)
-        int recv_len = recvfrom(sockfd, &pkt, sizeof(Packet), 0, 
-                                (struct sockaddr*)&from_addr, &from_len);
+        int recv_len = recv_packet(sockfd, &pkt, &from_addr, &from_len);
         
         if (recv_len <= 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -267,19 +268,36 @@ void download_file(int sockfd, const char *filename, struct sockaddr_in *server_
             break;
         }
         
-        printf("Recebido pacote tipo=%d seq=%d\n", pkt.type, pkt.seq_num);
+        LOG(LOG_PACKET, "Recebido pacote tipo=%d seq=%d\n", pkt.type, pkt.seq_num);
         
         if (pkt.type == PKT_ERROR) {
             printf(" Erro do servidor: %s\n", pkt.data);
+            
+            if (req.resume && strcmp(pkt.data, RESUME_MISMATCH_MSG) == 0) {
+                // O arquivo mudou no servidor: o parcial não serve mais
+                printf("↻ Arquivo mudou no servidor, recomeçando do zero\n");
+                if (ftruncate(fd, 0) == -1) perror("ftruncate");
+                lseek(fd, 0, SEEK_SET);
+                expected_seq = checkpoint_seq = 0;
+                prefix_hash = resume_hash_init();
+                req.range_first = 0;
+                req.resume = 0;
+                send_packet(sockfd, &req, server_addr, addr_len);
+                continue;
+            }
+            
             close(fd);
             unlink(download_filename);
+            checkpoint_remove(download_filename);
             return;
         }
         
         if (pkt.type == PKT_END) {
             // Envia ACK para o endereço que enviou (pode ser porta diferente)
             send_ack(sockfd, pkt.seq_num, &from_addr, from_len);
+            log_flush();
             printf("\n✓ Download concluído: %s\n", download_filename);
+            completed = 1;
             break;
         }
         
@@ -289,21 +307,27 @@ void download_file(int sockfd, const char *filename, struct sockaddr_in *server_
             unsigned int calculated_checksum = calculate_checksum(pkt.data, pkt.data_len);
             
             if (received_checksum != calculated_checksum) {
-                printf(" Checksum inválido para seq=%d! Descartando.\n", pkt.seq_num);
+                LOG(LOG_WARN, " Checksum inválido para seq=%d! Descartando.\n", pkt.seq_num);
                 continue;
             }
             
             if (pkt.seq_num == expected_seq) {
                 write(fd, pkt.data, pkt.data_len);
-                printf("Pacote %d escrito (%d bytes) ✓ Checksum OK\n", 
-                       pkt.seq_num, pkt.data_len);
+                LOG(LOG_PACKET, "Pacote %d escrito (%d bytes) ✓ Checksum OK\n", 
+                    pkt.seq_num, pkt.data_len);
                 
                 // Envia ACK para o endereço que enviou (pode ser porta diferente)
                 send_ack(sockfd, pkt.seq_num, &from_addr, from_len);
                 expected_seq++;
+                prefix_hash = resume_hash_step(prefix_hash, pkt.checksum);
+                
+                if (expected_seq - checkpoint_seq >= CHECKPOINT_INTERVAL) {
+                    checkpoint_sequential(&ck, expected_seq, prefix_hash);
+                    if (checkpoint_save(download_filename, fd, &ck) == 0) checkpoint_seq = expected_seq;
+                }
             } else {
-                printf("Pacote fora de ordem: esperado=%d, recebido=%d\n", 
-                       expected_seq, pkt.seq_num);
+                LOG(LOG_WARN, "Pacote fora de ordem: esperado=%d, recebido=%d\n", 
+                    expected_seq, pkt.seq_num);
                 if (expected_seq > 0) {
                     send_ack(sockfd, expected_seq - 1, &from_addr, from_len);
                 }
@@ -311,6 +335,15 @@ void download_file(int sockfd, const char *filename, struct sockaddr_in *server_
         }
     }
     
+    // Concluído remove o checkpoint; interrompido grava o progresso para retomar
+    if (completed) {
+        checkpoint_remove(download_filename);
+    } else if (expected_seq > checkpoint_seq) {
+        checkpoint_sequential(&ck, expected_seq, prefix_hash);
+        checkpoint_save(download_filename, fd, &ck);
+        printf("💾 Checkpoint salvo: %d pacotes recebidos\n", expected_seq);
+    }
+    
     close(fd);
     printf("═══════════════════════════════════════════\n\n");
 }
@@ -328,6 +361,9 @@ int main(void)
     printf("   CLIENTE FTP UDP - STOP AND WAIT\n");
     printf("═══════════════════════════════════════════\n\n");
     
+    // Motor didático: o log por pacote continua ligado, mas fora do laço de envio
+    log_start(LOG_PACKET);
+    
     if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
         die("socket");
     }
@@ -353,6 +389,7 @@ int main(void)
     printf("  sair               - Encerrar cliente\n\n");
     
     while (1) {
+        log_flush();
         printf("> ");
         fgets(command, sizeof(command), stdin);
         command[strcspn(command, "\n")] = 0;
@@ -3,8 +3,12 @@
     Suporta upload e download de arquivos com threads paralelas
     - Corrigido bug de leitura de arquivos
     - Socket dedicado por thread (sem race condition)
-    - Checksum CRC32 para integridade
-    - Timeout adaptativo
+    - Checksum CRC32 para integridade (acelerado, ver ../checksum.h)
+    - Formato compacto no fio (ver ../protocol.h)
+    - Timeout adaptativo: RTT em ns com regra de Karn e RTO da RFC 6298 (ver ../rtt.h)
+    - Retomada: transferência interrompida continua do checkpoint (ver ../checkpoint.h)
+    - Telemetria por sessão (--stats <arquivo>), ver ../telemetry.h
+    - Log assíncrono por pacote (ver ../log.h)
 */
 #include <stdio.h>
 #include <string.h>
@@ -20,30 +24,17 @@
 #include <cmath>
 #include <ifaddrs.h>
 
-#define BUFLEN 1024
+#include "../protocol.h"
+#include "../checksum.h"
+#include "../checkpoint.h"
+#include "../telemetry.h"
+#include "../log.h"
+#include "../rtt.h"
+
 #define PORT 9999
 #define INITIAL_TIMEOUT_SEC 5
 #define MAX_RETRIES 5
-#define ALPHA 0.125  // Fator para RTT médio (usado em timeout adaptativo)
-#define BETA 0.25    // Fator para variação de RTT
-
-// Tipos de pacotes
-#define PKT_UPLOAD_REQUEST 1
-#define PKT_DOWNLOAD_REQUEST 2
-#define PKT_DATA 3
-#define PKT_ACK 4
-#define PKT_END 5
-#define PKT_ERROR 6
-
-// Estrutura do pacote com checksum
-typedef struct {
-    int type;
-    int seq_num;
-    int data_len;
-    char filename[256];
-    char data[BUFLEN];
-    unsigned int checksum;  // CRC32 para integridade
-} Packet;
+#define SW_RTO_MIN_NS 50000000LL  // RTO mínimo (50 ms): 5 tentativas cobrem ~1,5 s de backoff
 
 // Estrutura para thread com socket dedicado
 typedef struct {
@@ -51,8 +42,8 @@ typedef struct {
     socklen_t addr_len;
     int sockfd;  // Socket dedicado para esta thread
     Packet request;
-    double estimated_rtt;  // RTT estimado para timeout adaptativo
-    double dev_rtt;        // Desvio do RTT
+    RttEstimator rtt;      // RTT/RTO para timeout adaptativo
+    TransferStats *stats;  // Telemetria da sessão (NULL sem --stats)
 } ThreadArgs;
 
 void die(const char *s)
@@ -61,33 +52,10 @@ void die(const char *s)
     exit(1);
 }
 
-// Calcular CRC32 simples (checksum)
-unsigned int calculate_checksum(const char *data, int len)
-{
-    unsigned int crc = 0xFFFFFFFF;
-    for (int i = 0; i < len; i++) {
-        crc ^= (unsigned char)data[i];
-        for (int j = 0; j < 8; j++) {
-            if (crc & 1)
-                crc = (crc >> 1) ^ 0xEDB88320;
-            else
-                crc >>= 1;
-        }
-    }
-    return ~crc;
-}
-
-// Obter timestamp em milissegundos
-long long get_timestamp_ms()
-{
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (long long)(tv.tv_sec) * 1000 + (tv.tv_usec) / 1000;
-}
-
 // MELHORADO: Função para enviar pacote com retransmissão e timeout adaptativo
 int send_packet_with_ack(int sockfd, Packet *pkt, struct sockaddr_in *addr, 
-                         socklen_t addr_len, double *estimated_rtt, double *dev_rtt)
+                         socklen_t addr_len, RttEstimator *rtt,
+                         TransferStats *stats)
 {
     Packet ack;
     int tentativa = 0;
@@ -95,58 +63,57 @@ int send_packet_with_ack(int sockfd, Packet *pkt, struct sockaddr_in *addr,
     // Calcular checksum antes de enviar
     pkt->checksum = calculate_checksum(pkt->data, pkt->data_len);
     
-    // MELHORADO: Timeout adaptativo baseado no RTT
-    int timeout_ms = (int)((*estimated_rtt + 4 * (*dev_rtt)) * 1000);
-    if (timeout_ms < 1000) timeout_ms = 200;  // Mínimo 200 milissegundos
-    if (timeout_ms > 10000) timeout_ms = 3000; // Máximo 3 segundos
-    
-    struct timeval tv;
-    tv.tv_sec = timeout_ms / 1000;
-    tv.tv_usec = (timeout_ms % 1000) * 1000;
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-    
     while (tentativa < MAX_RETRIES) {
-        long long send_time = get_timestamp_ms();
+        // Timeout adaptativo: RTO atual, já com o backoff dos timeouts anteriores
+        long long timeout_ns = rtt_rto_ns(rtt);
+        struct timeval tv;
+        tv.tv_sec = timeout_ns / 1000000000LL;
+        tv.tv_usec = (timeout_ns % 1000000000LL) / 1000;
+        setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        
+        long long send_time = now_ns();
         
         // Enviar pacote
-        if (sendto(sockfd, pkt, sizeof(Packet), 0, (struct sockaddr*)addr, addr_len) == -1) {
+        if (send_packet(sockfd, pkt, addr, addr_len) == -1) {
             perror("sendto");
             return -1;
         }
+        TELEMETRY_ADD(stats, packets, 1);
+        if (tentativa > 0) TELEMETRY_ADD(stats, retransmits, 1);
+        TELEMETRY_SET(stats, window, 1);
         
-        printf("  Enviado seq=%d (tent. %d/%d, timeout=%dms)\n", 
-               pkt->seq_num, tentativa + 1, MAX_RETRIES, timeout_ms);
+        LOG(LOG_PACKET, "  Enviado seq=%d (tent. %d/%d, timeout=%.1fms)\n", 
+            pkt->seq_num, tentativa + 1, MAX_RETRIES, timeout_ns / 1e6);
         
         // Aguardar ACK
         memset(&ack, 0, sizeof(Packet));
-        int recv_len = recvfrom(sockfd, &ack, sizeof(Packet), 0, 
-                               (struct sockaddr*)addr, &addr_len);
+        int recv_len = recv_packet(sockfd, &ack, addr, &addr_len);
         
         if (recv_len > 0 && ack.type == PKT_ACK && ack.seq_num == pkt->seq_num) {
-            long long recv_time = get_timestamp_ms();
-            double sample_rtt = (recv_time - send_time) / 1000.0; // em segundos
+            long long sample_ns = now_ns() - send_time;
             
-            // Atualizar RTT estimado (algoritmo de Jacobson/Karels)
-            *dev_rtt = (1 - BETA) * (*dev_rtt) + BETA * fabs(sample_rtt - *estimated_rtt);
-            *estimated_rtt = (1 - ALPHA) * (*estimated_rtt) + ALPHA * sample_rtt;
+            // Atualizar RTT estimado só com pacote não retransmitido (regra de Karn)
+            if (tentativa == 0) rtt_sample(rtt, sample_ns);
+            telemetry_rtt(stats, rtt_srtt_s(rtt), rtt_rttvar_s(rtt));
+            TELEMETRY_ADD(stats, bytes, pkt->data_len);
+            TELEMETRY_SET(stats, window, 0);
             
             if (pkt->seq_num % 10 == 0) {
-                printf("  ✓ seq=%d (RTT=%.0fms)     \n", pkt->seq_num, sample_rtt * 1000);
+                LOG(LOG_PACKET, "  ✓ seq=%d (RTT=%.3fms)     \n", pkt->seq_num, sample_ns / 1e6);
             }
             return 0;
         }
         
         if (recv_len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-            printf("  ⚠️  Timeout aguardando ACK seq=%d\n", pkt->seq_num);
-            // Aumentar timeout após timeout (backoff exponencial)
-            timeout_ms = (int)(timeout_ms * 1.2);
-            if (timeout_ms > 3000) timeout_ms = 3000;
+            LOG(LOG_WARN, "  ⚠️  Timeout aguardando ACK seq=%d\n", pkt->seq_num);
+            // Dobra o RTO até a próxima amostra válida (backoff exponencial)
+            rtt_on_timeout(rtt);
         }
         
         tentativa++;
     }
     
-    printf("  Falha após %d tentativas para seq=%d\n", MAX_RETRIES, pkt->seq_num);
+    LOG(LOG_ERROR, "  Falha após %d tentativas para seq=%d\n", MAX_RETRIES, pkt->seq_num);
     return -1;
 }
 
@@ -158,8 +125,24 @@ void send_ack(int sockfd, int seq_num, struct sockaddr_in *addr, socklen_t addr_
     ack.type = PKT_ACK;
     ack.seq_num = seq_num;
     
-    sendto(sockfd, &ack, sizeof(Packet), 0, (struct sockaddr*)addr, addr_len);
-    printf("  ACK enviado para seq=%d\n", seq_num);
+    send_packet(sockfd, &ack, addr, addr_len);
+    LOG(LOG_PACKET, "  ACK enviado para seq=%d\n", seq_num);
+}
+
+// ACK da requisição de upload: cum_ack = pacotes já recebidos (ponto de
+// retomada) e checksum = hash desse prefixo, para o cliente conferir
+void send_upload_ack(int sockfd, int base, uint32_t prefix_hash,
+                     struct sockaddr_in *addr, socklen_t addr_len)
+{
+    Packet ack;
+    memset(&ack, 0, sizeof(Packet));
+    ack.type = PKT_ACK;
+    ack.seq_num = 0;
+    ack.cum_ack = base;
+    ack.checksum = prefix_hash;
+    
+    send_packet(sockfd, &ack, addr, addr_len);
+    printf("  ACK enviado para seq=0 (retomada em %d)\n", base);
 }
 
 // MELHORADO: Thread para DOWNLOAD (servidor envia arquivo para cliente)
@@ -203,8 +186,8 @@ void* thread_download(void* arg)
         memset(&error_pkt, 0, sizeof(Packet));
         error_pkt.type = PKT_ERROR;
         strcpy(error_pkt.data, "Arquivo nao encontrado");
-        sendto(sockfd, &error_pkt, sizeof(Packet), 0, 
-               (struct sockaddr*)&args->client_addr, args->addr_len);
+        error_pkt.data_len = strlen(error_pkt.data);
+        send_packet(sockfd, &error_pkt, &args->client_addr, args->addr_len);
         
         close(sockfd);
         free(args);
@@ -216,6 +199,35 @@ void* thread_download(void* arg)
     int seq_num = 0;
     int bytes_read;
     
+    // Retomada: pula o que o cliente já tem, se o hash do prefixo conferir
+    if (args->request.resume && args->request.range_first > 0) {
+        uint32_t hash;
+        if (resume_hash_file(fd, args->request.range_first, &hash) == -1 ||
+            hash != args->request.resume_hash) {
+            printf("[DOWNLOAD] Checkpoint do cliente não confere, retomada recusada\n");
+            
+            Packet error_pkt;
+            memset(&error_pkt, 0, sizeof(Packet));
+            error_pkt.type = PKT_ERROR;
+            strcpy(error_pkt.data, RESUME_MISMATCH_MSG);
+            error_pkt.data_len = strlen(error_pkt.data);
+            send_packet(sockfd, &error_pkt, &args->client_addr, args->addr_len);
+            
+            close(fd);
+            close(sockfd);
+            free(args);
+            return NULL;
+        }
+        seq_num = args->request.range_first;
+        lseek(fd, (off_t)seq_num * BUFLEN, SEEK_SET);
+        printf("[DOWNLOAD] ↻ Retomando do pacote %d\n", seq_num);
+    }
+    
+    // Stop-and-wait: janela de congestionamento fixa em 1 pacote
+    args->stats = telemetry_begin("download", args->request.session_id,
+                                  args->request.filename, &args->client_addr);
+    TELEMETRY_SET(args->stats, cwnd, 1);
+    
     while (1) {
         memset(&pkt, 0, sizeof(Packet));
         
@@ -228,11 +240,12 @@ void* thread_download(void* arg)
         pkt.seq_num = seq_num;
         pkt.data_len = bytes_read;
         
-        printf("[DOWNLOAD] Enviando pacote %d (%d bytes)\n", seq_num, bytes_read);
+        LOG(LOG_PACKET, "[DOWNLOAD] Enviando pacote %d (%d bytes)\n", seq_num, bytes_read);
         
         if (send_packet_with_ack(sockfd, &pkt, &args->client_addr, args->addr_len,
-                                &args->estimated_rtt, &args->dev_rtt) == -1) {
+                                &args->rtt, args->stats) == -1) {
             printf("[DOWNLOAD] Falha ao enviar pacote %d\n", seq_num);
+            telemetry_end(args->stats);
             close(fd);
             close(sockfd);
             free(args);
@@ -251,10 +264,11 @@ void* thread_download(void* arg)
     
     printf("[DOWNLOAD] Enviando pacote END\n");
     send_packet_with_ack(sockfd, &pkt, &args->client_addr, args->addr_len,
-                        &args->estimated_rtt, &args->dev_rtt);
+                        &args->rtt, args->stats);
     
     printf("[DOWNLOAD] ✓ Transferência concluída: %s (%d pacotes)\n", 
            args->request.filename, seq_num);
+    telemetry_end(args->stats);
     
     close(sockfd);
     free(args);
@@ -278,7 +292,12 @@ void* thread_upload(void* arg)
     char upload_filename[300];
     snprintf(upload_filename, sizeof(upload_filename), "received_%s", args->request.filename);
     
-    int fd = creat(upload_filename, 0666);
+    // Retomada pedida e checkpoint válido: mantém o arquivo parcial
+    Checkpoint ck;
+    int resume = args->request.resume && checkpoint_load(upload_filename, &ck) == 0;
+    if (!resume) checkpoint_remove(upload_filename);
+    
+    int fd = resume ? open(upload_filename, O_WRONLY) : creat(upload_filename, 0666);
     if (fd == -1) {
         printf("[UPLOAD] Erro ao criar arquivo: %s\n", upload_filename);
         
@@ -286,19 +305,32 @@ void* thread_upload(void* arg)
         memset(&error_pkt, 0, sizeof(Packet));
         error_pkt.type = PKT_ERROR;
         strcpy(error_pkt.data, "Erro ao criar arquivo no servidor");
-        sendto(sockfd, &error_pkt, sizeof(Packet), 0, 
-               (struct sockaddr*)&args->client_addr, args->addr_len);
+        error_pkt.data_len = strlen(error_pkt.data);
+        send_packet(sockfd, &error_pkt, &args->client_addr, args->addr_len);
         
         free(args);
         return NULL;
     }
     
-    // Enviar ACK para requisição inicial
-    send_ack(sockfd, 0, &args->client_addr, args->addr_len);
+    int expected_seq = 0;
+    uint32_t prefix_hash = resume_hash_init();
+    if (resume) {
+        expected_seq = ck.base;
+        prefix_hash = ck.prefix_hash;
+        lseek(fd, (off_t)expected_seq * BUFLEN, SEEK_SET);
+        printf("[UPLOAD] ↻ Retomando do pacote %d\n", expected_seq);
+    }
+    int checkpoint_seq = expected_seq;
+    int completed = 0;
+    
+    args->stats = telemetry_begin("upload", args->request.session_id,
+                                  args->request.filename, &args->client_addr);
+    
+    // Enviar ACK para requisição inicial (com o ponto de retomada)
+    send_upload_ack(sockfd, expected_seq, prefix_hash, &args->client_addr, args->addr_len);
     
     // Receber pacotes de dados
     Packet pkt;
-    int expected_seq = 0;
     
     // Configurar timeout inicial
     struct timeval tv;
@@ -309,8 +341,7 @@ void* thread_upload(void* arg)
     while (1) {
         memset(&pkt, 0, sizeof(Packet));
         
-        int recv_len = recvfrom(sockfd, &pkt, sizeof(Packet), 0, 
-                                (struct sockaddr*)&args->client_addr, &args->addr_len);
+        int recv_len = recv_packet(sockfd, &pkt, &args->client_addr, &args->addr_len);
         
         if (recv_len <= 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -319,22 +350,26 @@ void* thread_upload(void* arg)
             break;
         }
         
-        printf("[UPLOAD] Recebido pacote tipo=%d seq=%d\n", pkt.type, pkt.seq_num);
+        LOG(LOG_PACKET, "[UPLOAD] Recebido pacote tipo=%d seq=%d\n", pkt.type, pkt.seq_num);
         
         if (pkt.type == PKT_END) {
             send_ack(sockfd, pkt.seq_num, &args->client_addr, args->addr_len);
             printf("[UPLOAD] ✓ Transferência concluída: %s\n", upload_filename);
+            completed = 1;
             break;
         }
         
         if (pkt.type == PKT_DATA) {
+            TELEMETRY_ADD(args->stats, packets, 1);
+            
             // Verificar checksum
             unsigned int received_checksum = pkt.checksum;
             unsigned int calculated_checksum = calculate_checksum(pkt.data, pkt.data_len);
             
             if (received_checksum != calculated_checksum) {
-                printf("[UPLOAD] Checksum inválido para seq=%d! Descartando pacote.\n", 
-                       pkt.seq_num);
+                LOG(LOG_WARN, "[UPLOAD] Checksum inválido para seq=%d! Descartando pacote.\n", 
+                    pkt.seq_num);
+                TELEMETRY_ADD(args->stats, checksum_failures, 1);
                 // Não envia ACK, forçando retransmissão
                 continue;
             }
@@ -342,15 +377,23 @@ void* thread_upload(void* arg)
             if (pkt.seq_num == expected_seq) {
                 // Escrever dados no arquivo
                 write(fd, pkt.data, pkt.data_len);
-                printf("[UPLOAD] Pacote %d escrito (%d bytes) ✓ Checksum OK\n", 
-                       pkt.seq_num, pkt.data_len);
+                TELEMETRY_ADD(args->stats, bytes, pkt.data_len);
+                LOG(LOG_PACKET, "[UPLOAD] Pacote %d escrito (%d bytes) ✓ Checksum OK\n", 
+                    pkt.seq_num, pkt.data_len);
                 
                 // Enviar ACK
                 send_ack(sockfd, pkt.seq_num, &args->client_addr, args->addr_len);
                 expected_seq++;
+                prefix_hash = resume_hash_step(prefix_hash, pkt.checksum);
+                
+                if (expected_seq - checkpoint_seq >= CHECKPOINT_INTERVAL) {
+                    checkpoint_sequential(&ck, expected_seq, prefix_hash);
+                    if (checkpoint_save(upload_filename, fd, &ck) == 0) checkpoint_seq = expected_seq;
+                }
             } else {
-                printf("[UPLOAD] Pacote fora de ordem: esperado=%d, recebido=%d\n", 
-                       expected_seq, pkt.seq_num);
+                LOG(LOG_WARN, "[UPLOAD] Pacote fora de ordem: esperado=%d, recebido=%d\n", 
+                    expected_seq, pkt.seq_num);
+                TELEMETRY_ADD(args->stats, retransmits, 1);
                 // Reenviar último ACK válido
                 if (expected_seq > 0) {
                     send_ack(sockfd, expected_seq - 1, &args->client_addr, args->addr_len);
@@ -359,12 +402,22 @@ void* thread_upload(void* arg)
         }
     }
     
+    // Concluído remove o checkpoint; interrompido grava o progresso para retomar
+    if (completed) {
+        checkpoint_remove(upload_filename);
+    } else if (expected_seq > checkpoint_seq) {
+        checkpoint_sequential(&ck, expected_seq, prefix_hash);
+        checkpoint_save(upload_filename, fd, &ck);
+        printf("[UPLOAD] 💾 Checkpoint salvo: %d pacotes recebidos\n", expected_seq);
+    }
+    
+    telemetry_end(args->stats);
     close(fd);
     free(args);
     return NULL;
 }
 
-int main(void)
+int main(int argc, char *argv[])
 {
     struct sockaddr_in si_me, si_other;
     int s;
@@ -375,6 +428,20 @@ int main(void)
     printf("   SERVIDOR FTP UDP - STOP AND WAIT\n");
     printf("═══════════════════════════════════════════\n\n");
     
+    // Opção: --stats <arquivo>
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            telemetry_start(argv[++i], "stop-wait");
+            printf("📈 Telemetria: %s (a cada %d ms)\n\n", argv[i], TELEMETRY_INTERVAL_MS);
+        } else {
+            fprintf(stderr, "Uso: %s [--stats <arquivo>]\n", argv[0]);
+            return 1;
+        }
+    }
+    
+    // Motor didático: o log por pacote continua ligado, mas fora da thread da transferência
+    log_start(LOG_PACKET);
+    
     // Criar socket UDP principal (apenas para receber requisições)
     if ((s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1) {
         die("socket");
@@ -441,8 +508,7 @@ int main(void)
         memset(&pkt, 0, sizeof(Packet));
         
         // Receber requisição
-        int recv_len = recvfrom(s, &pkt, sizeof(Packet), 0, 
-                                (struct sockaddr*)&si_other, &slen);
+        int recv_len = recv_packet(s, &pkt, &si_other, &slen);
         
         if (recv_len <= 0) continue;
         
@@ -456,8 +522,8 @@ int main(void)
         args->addr_len = slen;
         args->sockfd = s;  // Socket será substituído por um dedicado na thread
         args->request = pkt;
-        args->estimated_rtt = 1.0;  // RTT inicial estimado de 1 segundo
-        args->dev_rtt = 0.5;         // Desvio inicial de 0.5 segundo
+        rtt_init(&args->rtt, SW_RTO_MIN_NS);  // RTO inicial de 1 segundo
+        args->stats = NULL;
         
         pthread_t thread_id;
         
@@ -0,0 +1,254 @@
+/*
+    Telemetria por transferência dos servidores
+    Compartilhado por sliding-window/server.cpp e stop-wait/sw_server.cpp
+
+    Cada transferência ocupa um slot de um registro fixo com contadores
+    inteiros que a própria transferência atualiza com atômicos relaxados:
+    nenhum lock, E/S ou formatação no caminho dos dados. Com --stats <arquivo>
+    uma thread à parte regrava o arquivo a cada TELEMETRY_INTERVAL_MS no
+    formato texto do Prometheus (temporário + rename: quem lê nunca vê um
+    arquivo pela metade), pronto para o coletor textfile do node_exporter ou
+    qualquer outro scraper.
+
+    Por transferência: bytes entregues, goodput, pacotes DATA, retransmissões
+    (no upload, duplicatas recebidas), falhas de checksum, SRTT/RTTVAR, ocupação
+    da janela (em voo no envio, fora de ordem na recepção) e cwnd. Encerradas
+    continuam no arquivo por TELEMETRY_LINGER_MS com os valores finais.
+    Sem --stats, telemetry_begin() devolve NULL e as macros não fazem nada.
+    Métricas do processo (ex.: o cache de arquivos do servidor) entram no
+    mesmo arquivo por telemetry_extra.
+*/
+#ifndef FTP_TELEMETRY_H
+#define FTP_TELEMETRY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#define TELEMETRY_SLOTS 1024
+#define TELEMETRY_INTERVAL_MS 1000
+#define TELEMETRY_LINGER_MS 60000
+
+#define TELEMETRY_FREE 0
+#define TELEMETRY_ACTIVE 1
+#define TELEMETRY_DONE 2
+
+typedef struct {
+    int state;                    // TELEMETRY_* (alterado com telemetry_lock)
+    unsigned long long id;        // Número da transferência no processo
+    uint32_t session_id;
+    char kind[12];                // "download", "upload"
+    char file[128];
+    char peer[32];
+    long long start_ms;
+    long long end_ms;
+    // Contadores (atômicos relaxados)
+    long long bytes;              // Payload entregue: confirmado (envio) ou escrito (recepção)
+    long long packets;            // DATA enviados (com retransmissões) ou recebidos
+    long long retransmits;        // Retransmitidos (envio) ou duplicatas recebidas
+    long long checksum_failures;
+    long long srtt_us;
+    long long rttvar_us;
+    long long window;             // Pacotes em voo (envio) ou fora de ordem (recepção)
+    long long cwnd;
+} TransferStats;
+
+static TransferStats telemetry_slots[TELEMETRY_SLOTS];
+static pthread_mutex_t telemetry_lock = PTHREAD_MUTEX_INITIALIZER;
+static const char *telemetry_path = NULL;
+static const char *telemetry_engine = "";
+static unsigned long long telemetry_next_id = 1;
+static unsigned long long telemetry_transfers = 0;
+static void (*telemetry_extra)(FILE *f) = NULL;   // Métricas extras do servidor
+
+#define TELEMETRY_ADD(st, field, n) \
+    do { if (st) __atomic_fetch_add(&(st)->field, (long long)(n), __ATOMIC_RELAXED); } while (0)
+#define TELEMETRY_SET(st, field, v) \
+    do { if (st) __atomic_store_n(&(st)->field, (long long)(v), __ATOMIC_RELAXED); } while (0)
+
+static inline long long telemetry_now_ms(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// Estimativas de RTT em segundos, como mantidas pelos remetentes
+static inline void telemetry_rtt(TransferStats *st, double srtt, double rttvar)
+{
+    TELEMETRY_SET(st, srtt_us, srtt * 1e6);
+    TELEMETRY_SET(st, rttvar_us, rttvar * 1e6);
+}
+
+// Registra uma transferência; NULL sem --stats ou com o registro cheio
+static inline TransferStats *telemetry_begin(const char *kind, uint32_t session_id,
+                                             const char *file, const struct sockaddr_in *peer)
+{
+    if (!telemetry_path) return NULL;
+
+    pthread_mutex_lock(&telemetry_lock);
+    TransferStats *st = NULL;
+    for (int i = 0; i < TELEMETRY_SLOTS && !st; i++) {
+        if (telemetry_slots[i].state == TELEMETRY_FREE) st = &telemetry_slots[i];
+    }
+    // Sem slot livre: reaproveita a encerrada há mais tempo
+    for (int i = 0; i < TELEMETRY_SLOTS && !st; i++) {
+        TransferStats *old = &telemetry_slots[i];
+        if (old->state == TELEMETRY_DONE && (!st || old->end_ms < st->end_ms)) st = old;
+    }
+    if (st) {
+        memset(st, 0, sizeof(*st));
+        st->id = telemetry_next_id++;
+        st->session_id = session_id;
+        snprintf(st->kind, sizeof(st->kind), "%s", kind);
+        snprintf(st->file, sizeof(st->file), "%.*s", (int)sizeof(st->file) - 1, file);
+        snprintf(st->peer, sizeof(st->peer), "%s:%d", inet_ntoa(peer->sin_addr), ntohs(peer->sin_port));
+        st->start_ms = telemetry_now_ms();
+        st->state = TELEMETRY_ACTIVE;
+        telemetry_transfers++;
+    }
+    pthread_mutex_unlock(&telemetry_lock);
+    return st;
+}
+
+// Fim da transferência: os valores ficam congelados até o slot expirar
+static inline void telemetry_end(TransferStats *st)
+{
+    if (!st) return;
+    pthread_mutex_lock(&telemetry_lock);
+    st->end_ms = telemetry_now_ms();
+    st->state = TELEMETRY_DONE;
+    pthread_mutex_unlock(&telemetry_lock);
+}
+
+// Valor de rótulo com \, " e quebra de linha escapados
+static inline void telemetry_label(FILE *f, const char *value)
+{
+    for (const char *p = value; *p; p++) {
+        if (*p == '\\' || *p == '"') fputc('\\', f);
+        if (*p == '\n') {
+            fputs("\\n", f);
+            continue;
+        }
+        fputc(*p, f);
+    }
+}
+
+// Métricas por transferência, na ordem do arquivo
+enum {
+    TM_BYTES, TM_GOODPUT, TM_PACKETS, TM_RETRANSMITS, TM_CHECKSUM, TM_SRTT, TM_RTTVAR,
+    TM_WINDOW, TM_CWND, TM_ACTIVE, TM_DURATION, TM_COUNT
+};
+
+static const struct {
+    const char *name;
+    const char *type;
+    const char *help;
+} telemetry_metrics[TM_COUNT] = {
+    { "ftp_transfer_bytes", "gauge", "Bytes de payload entregues" },
+    { "ftp_transfer_goodput_bytes_per_second", "gauge", "Bytes entregues por segundo de transferencia" },
+    { "ftp_transfer_packets", "gauge", "Pacotes DATA enviados (com retransmissoes) ou recebidos" },
+    { "ftp_transfer_retransmits", "gauge", "Pacotes retransmitidos (envio) ou duplicatas recebidas (recepcao)" },
+    { "ftp_transfer_checksum_failures", "gauge", "Pacotes descartados por checksum invalido" },
+    { "ftp_transfer_srtt_seconds", "gauge", "RTT suavizado do remetente" },
+    { "ftp_transfer_rttvar_seconds", "gauge", "Variacao do RTT do remetente" },
+    { "ftp_transfer_window_packets", "gauge", "Pacotes em voo (envio) ou fora de ordem (recepcao)" },
+    { "ftp_transfer_cwnd_packets", "gauge", "Janela de congestionamento do remetente" },
+    { "ftp_transfer_active", "gauge", "1 enquanto a transferencia esta em andamento" },
+    { "ftp_transfer_duration_seconds", "gauge", "Duracao da transferencia" },
+};
+
+static inline double telemetry_value(const TransferStats *st, int metric, long long now)
+{
+    long long end = st->state == TELEMETRY_ACTIVE ? now : st->end_ms;
+    double seconds = (end - st->start_ms) / 1000.0;
+    long long bytes = __atomic_load_n(&st->bytes, __ATOMIC_RELAXED);
+
+    switch (metric) {
+    case TM_BYTES:       return (double)bytes;
+    case TM_GOODPUT:     return seconds > 0 ? bytes / seconds : 0.0;
+    case TM_PACKETS:     return (double)__atomic_load_n(&st->packets, __ATOMIC_RELAXED);
+    case TM_RETRANSMITS: return (double)__atomic_load_n(&st->retransmits, __ATOMIC_RELAXED);
+    case TM_CHECKSUM:    return (double)__atomic_load_n(&st->checksum_failures, __ATOMIC_RELAXED);
+    case TM_SRTT:        return __atomic_load_n(&st->srtt_us, __ATOMIC_RELAXED) / 1e6;
+    case TM_RTTVAR:      return __atomic_load_n(&st->rttvar_us, __ATOMIC_RELAXED) / 1e6;
+    case TM_WINDOW:      return (double)__atomic_load_n(&st->window, __ATOMIC_RELAXED);
+    case TM_CWND:        return (double)__atomic_load_n(&st->cwnd, __ATOMIC_RELAXED);
+    case TM_ACTIVE:      return st->state == TELEMETRY_ACTIVE ? 1.0 : 0.0;
+    case TM_DURATION:    return seconds;
+    }
+    return 0.0;
+}
+
+// Regrava o arquivo de estatísticas (e libera as encerradas há muito tempo)
+static inline void telemetry_write(void)
+{
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", telemetry_path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return;
+
+    long long now = telemetry_now_ms();
+    pthread_mutex_lock(&telemetry_lock);
+
+    int active = 0;
+    for (int i = 0; i < TELEMETRY_SLOTS; i++) {
+        TransferStats *st = &telemetry_slots[i];
+        if (st->state == TELEMETRY_DONE && now - st->end_ms > TELEMETRY_LINGER_MS) {
+            st->state = TELEMETRY_FREE;
+        }
+        if (st->state == TELEMETRY_ACTIVE) active++;
+    }
+    fprintf(f, "# HELP ftp_server_transfers_active Transferencias em andamento\n");
+    fprintf(f, "# TYPE ftp_server_transfers_active gauge\n");
+    fprintf(f, "ftp_server_transfers_active{engine=\"%s\"} %d\n", telemetry_engine, active);
+    fprintf(f, "# HELP ftp_server_transfers_total Transferencias iniciadas\n");
+    fprintf(f, "# TYPE ftp_server_transfers_total counter\n");
+    fprintf(f, "ftp_server_transfers_total{engine=\"%s\"} %llu\n", telemetry_engine, telemetry_transfers);
+    if (telemetry_extra) telemetry_extra(f);
+
+    for (int m = 0; m < TM_COUNT; m++) {
+        fprintf(f, "# HELP %s %s\n", telemetry_metrics[m].name, telemetry_metrics[m].help);
+        fprintf(f, "# TYPE %s %s\n", telemetry_metrics[m].name, telemetry_metrics[m].type);
+        for (int i = 0; i < TELEMETRY_SLOTS; i++) {
+            const TransferStats *st = &telemetry_slots[i];
+            if (st->state == TELEMETRY_FREE) continue;
+            fprintf(f, "%s{engine=\"%s\",transfer=\"%llu\",session=\"%08x\",kind=\"%s\",peer=\"%s\",file=\"",
+                    telemetry_metrics[m].name, telemetry_engine, st->id, st->session_id,
+                    st->kind, st->peer);
+            telemetry_label(f, st->file);
+            fprintf(f, "\"} %.15g\n", telemetry_value(st, m, now));
+        }
+    }
+    pthread_mutex_unlock(&telemetry_lock);
+
+    if (fclose(f) == 0) rename(tmp, telemetry_path);
+    else unlink(tmp);
+}
+
+static inline void *telemetry_thread(void *arg)
+{
+    (void)arg;
+    while (1) {
+        telemetry_write();
+        usleep(TELEMETRY_INTERVAL_MS * 1000);
+    }
+    return NULL;
+}
+
+// Liga a exportação para path; engine identifica o servidor nos rótulos
+static inline void telemetry_start(const char *path, const char *engine)
+{
+    telemetry_path = path;
+    telemetry_engine = engine;
+
+    pthread_t tid;
+    pthread_create(&tid, NULL, telemetry_thread, NULL);
+    pthread_detach(tid);
+}
+
+#endif